@@ -0,0 +1,283 @@
+#include "beam_search.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+using namespace std;
+using namespace scoring;
+using namespace propagation;
+
+// partial circuits kept after each step, unless set otherwise
+static const int DEFAULT_BEAM_WIDTH = 64;
+
+// circuits kept by the best tracker of a search
+static const int BEST_CIRCUIT_COUNT = 10;
+
+static vector<poly_t> sort_values(vector<poly_t> values) {
+  sort(values.begin(), values.end());
+  return values;
+}
+
+// FNV-1a over the powers of values in sorted order, with a separator between values
+static uint64_t hash_sorted_values(vector<poly_t> const & values) {
+  uint64_t hash = 14695981039346656037ull;
+  for(auto & value : values) {
+    for(int power : value) {
+      hash = (hash ^ (uint64_t) power) * 1099511628211ull;
+    }
+    hash = (hash ^ 0xffffffffull) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t hash_values(vector<poly_t> const & values) {
+  return hash_sorted_values(sort_values(values));
+}
+
+struct SortedValuesHash {
+  size_t operator()(vector<poly_t> const & values) const { return hash_sorted_values(values); }
+};
+
+BeamSearch::BeamSearch(const poly_t &polynomial, ScoringParams params, const Geometry &geometry)
+  : geometry(geometry),
+    poly(polynomial),
+    params(params),
+    limits(DEFAULT_LIMITS),
+    limit_stats{0, 0},
+    beam_width(DEFAULT_BEAM_WIDTH),
+    verbose(true),
+    best_tracker(make_shared<BestTracker>(BEST_CIRCUIT_COUNT)),
+    type_counts(3, 0) {
+  sort_canonical(& poly);
+  plan = make_scoring_plan(poly, limits.max_degree);
+
+  for(int unit_id = 0; unit_id < geometry.unit_count(); ++ unit_id) {
+    ++ type_counts[geometry.unit_type(unit_id)];
+  }
+}
+
+void BeamSearch::set_beam_width(int width) {
+  beam_width = max(1, width);
+}
+
+void BeamSearch::set_thread_count(int thread_count) {
+  if(thread_count > 1) {
+    pool.reset(new utils::work_stealing_pool(thread_count));
+  } else {
+    pool.reset();
+  }
+}
+
+void BeamSearch::set_verbose(bool enabled) {
+  verbose = enabled;
+}
+
+void BeamSearch::set_propagation_limits(const PropagationLimits &new_limits) {
+  limits = new_limits;
+  plan = make_scoring_plan(poly, limits.max_degree);
+}
+
+void BeamSearch::set_best_tracker(std::shared_ptr<BestTracker> tracker) {
+  best_tracker = tracker;
+}
+
+void BeamSearch::run_parallel(int count, std::function<void(int, PropagationStats *)> const &body) {
+  if(! pool) {
+    for(int index = 0; index < count; ++ index) {
+      body(index, & limit_stats);
+    }
+    return;
+  }
+
+  vector<PropagationStats> thread_stats(pool->size(), {0, 0});
+  pool->parallel_for(count, 1, [&](int begin, int end, int thread_id) {
+    for(int index = begin; index < end; ++ index) {
+      body(index, & thread_stats[thread_id]);
+    }
+  });
+
+  for(auto & stats : thread_stats) {
+    limit_stats.degree_limit_hits += stats.degree_limit_hits;
+    limit_stats.term_limit_hits += stats.term_limit_hits;
+  }
+}
+
+ScoreOutput BeamSearch::search(int max_units) {
+  PartialCircuit root {{{1}}, {}, compute_poly_distance(plan, {1}), 0};
+  root.hash = hash_values(root.values);
+  beam = {root};
+
+  // keyed on the values themselves, so that circuits whose hashes collide are both kept
+  unordered_set<vector<poly_t>, SortedValuesHash> seen {root.values};
+  ScoreOutput best_score = {0, numeric_limits<double>::lowest()};
+
+  for(int unit_count = 1; unit_count <= max_units; ++ unit_count) {
+    if(verbose) {
+      cout << "Performing iteration [ " << unit_count
+           << " / " << max_units << " ]"
+           << endl;
+    }
+    limit_stats = {0, 0};
+
+    // grow each circuit in the beam on its own
+    vector<vector<PartialCircuit>> expanded(beam.size());
+    run_parallel(beam.size(), [&](int index, PropagationStats * stats) {
+      expand(beam[index], stats, & expanded[index]);
+    });
+
+    vector<PartialCircuit> children;
+    for(auto & circuit_children : expanded) {
+      for(auto & child : circuit_children) {
+        children.push_back(std::move(child));
+      }
+    }
+    if(children.empty()) {
+      break;
+    }
+
+    // closest first, ties broken on the hash so that the order never depends on threads
+    sort(children.begin(), children.end(), [](PartialCircuit const & c1, PartialCircuit const & c2) {
+      return c1.distance != c2.distance ? c1.distance < c2.distance : c1.hash < c2.hash;
+    });
+
+    beam.clear();
+    for(auto & child : children) {
+      if(beam.size() == beam_width) {
+        break;
+      }
+      if(seen.insert(sort_values(child.values)).second) {
+        beam.push_back(std::move(child));
+      }
+    }
+    if(beam.empty()) {
+      break;
+    }
+
+    auto score_out = score_beam();
+    if(best_score.best_score < score_out.best_score) {
+      best_score.best_score = score_out.best_score;
+    }
+    best_score.times_function_recovered = score_out.times_function_recovered;
+
+    if(verbose) {
+      cout << "\tbest score this iteration: "
+           << setprecision(2)
+           << score_out.best_score << endl
+           << "\tfunction was recovered "
+           << score_out.times_function_recovered
+           << " times" << endl
+           << "\tunit outputs over the degree limit: "
+           << limit_stats.degree_limit_hits
+           << ", over the term limit: "
+           << limit_stats.term_limit_hits << endl;
+    }
+
+    if(score_out.times_function_recovered > 0) {
+      break;
+    }
+  }
+
+  return best_score;
+}
+
+void BeamSearch::expand(const PartialCircuit &circuit, PropagationStats *stats,
+                        std::vector<PartialCircuit> *children) const {
+  vector<int> used(3, 0);
+  for(auto & step : circuit.steps) {
+    ++ used[step.unit_type];
+  }
+
+  auto add_child = [&](int unit_type, int operand1, int operand2) {
+    if(used[unit_type] == type_counts[unit_type]) {
+      return;
+    }
+
+    UnitOutput in1 {true, true, circuit.values[operand1]};
+    UnitOutput in2 {true, true, circuit.values[operand2]};
+    UnitOutput out = compute_one_unit_output(unit_type, in1, in2, limits, stats);
+    if(! out.has_output || ! out.is_valid ||
+       find(circuit.values.begin(), circuit.values.end(), out.poly) != circuit.values.end()) {
+      return;
+    }
+
+    PartialCircuit child = circuit;
+    child.distance = min(circuit.distance, compute_poly_distance(plan, out.poly));
+    child.values.push_back(std::move(out.poly));
+    child.steps.push_back({unit_type, operand1, operand2});
+    child.hash = hash_values(child.values);
+    children->push_back(std::move(child));
+  };
+
+  int value_count = circuit.values.size();
+  for(int operand1 = 0; operand1 < value_count; ++ operand1) {
+    for(int operand2 = operand1; operand2 < value_count; ++ operand2) {
+      add_child(0, operand1, operand2);
+      add_child(1, operand1, operand2);
+      add_child(2, operand1, operand2);
+      if(operand2 != operand1) {
+        add_child(2, operand2, operand1);
+      }
+    }
+  }
+}
+
+void BeamSearch::build_walker(const PartialCircuit &circuit, Walker *walker) const {
+  walker->reset();
+
+  // unit producing each value, taken in id order for each type
+  vector<int> value_units {geometry.array_input_id()};
+  vector<int> next_unit(3, 0);
+  for(auto & step : circuit.steps) {
+    int & unit_id = next_unit[step.unit_type];
+    while(geometry.unit_type(unit_id) != step.unit_type) {
+      ++ unit_id;
+    }
+
+    walker->rewire(unit_id * 2, value_units[step.operand1]);
+    walker->rewire(unit_id * 2 + 1, value_units[step.operand2]);
+    value_units.push_back(unit_id ++);
+  }
+}
+
+ScoreOutput BeamSearch::score_beam() {
+  vector<Walker> walkers(beam.size(), Walker(geometry));
+  vector<ScoreOutput> score_outs(beam.size());
+  vector<int> wire_lengths(beam.size(), 0);
+  run_parallel(beam.size(), [&](int index, PropagationStats * stats) {
+    build_walker(beam[index], & walkers[index]);
+    score_outs[index] = score_walker(& walkers[index], plan, params, limits, stats, & wire_lengths[index]);
+  });
+
+  // offered in beam order, so that circuits with the same score always come out in the same order
+  ScoreOutput best{0, numeric_limits<double>::lowest()};
+  for(int index = 0; index < beam.size(); ++ index) {
+    auto & score_out = score_outs[index];
+    if(best_tracker->would_accept(score_out.best_score)) {
+      best_tracker->offer({score_out.best_score, walkers[index].connections(), wire_lengths[index],
+                           score_out.times_function_recovered > 0});
+    }
+    best.best_score = max(best.best_score, score_out.best_score);
+    best.times_function_recovered += score_out.times_function_recovered > 0;
+  }
+  return best;
+}
+
+void BeamSearch::get_best_walkers(int count, std::vector<Walker> *best, std::vector<double> *best_scores) {
+  auto circuits = best_tracker->snapshot();
+  count = min<int>(count, circuits->size());
+
+  best->clear();
+  if(best_scores != nullptr) {
+    best_scores->clear();
+  }
+  for(int pos = 0; pos < count; ++ pos) {
+    auto & circuit = (*circuits)[pos];
+    best->push_back(Walker(geometry, circuit.conns));
+    if(best_scores != nullptr) {
+      best_scores->push_back(circuit.score);
+    }
+  }
+}
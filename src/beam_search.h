@@ -0,0 +1,100 @@
+#ifndef BEAMSEARCH_H
+#define BEAMSEARCH_H
+
+#include "definitions.h"
+#include "scoring.h"
+#include "propagation.h"
+#include "walker.h"
+#include "best_tracker.h"
+#include "stochastic_search.h"
+#include "utils/work_stealing_pool.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* Deterministic alternative to StochasticSearch for small targets: a beam
+ * search over partial circuits, growing them one unit at a time.
+ *
+ * A partial circuit is the list of polynomials its units produce, starting
+ * with x. Each step of the search adds one adder, multiplier or divider on
+ * any two of them, as computed by compute_one_unit_output, and keeps the
+ * beam_width partial circuits with an output closest to the target by
+ * compute_poly_distance. Partial circuits producing the same polynomials
+ * are equivalent, only the first one found is kept.
+ *
+ * Circuits in the beam are wired into walkers and scored like the walkers
+ * of StochasticSearch, and reported through the same BestTracker, so the
+ * results of both engines compare directly.
+ */
+class BeamSearch {
+  struct BeamStep {
+    int unit_type;
+    int operand1;
+    int operand2;
+  };
+
+  struct PartialCircuit {
+    // values[0] is x, then the output of each step
+    std::vector<poly_t> values;
+    std::vector<BeamStep> steps;
+
+    // smallest distance of a value to the target
+    double distance;
+
+    // of the values in sorted order, to break ties between equally close circuits
+    uint64_t hash;
+  };
+
+  Geometry geometry;
+  poly_t poly;
+  scoring::ScoringParams params;
+  scoring::ScoringPlan plan;
+  propagation::PropagationLimits limits;
+  propagation::PropagationStats limit_stats;
+
+  int beam_width;
+  bool verbose;
+  std::unique_ptr<utils::work_stealing_pool> pool;
+  std::shared_ptr<BestTracker> best_tracker;
+
+  // units of each type in the array
+  std::vector<int> type_counts;
+
+  std::vector<PartialCircuit> beam;
+
+  // every partial circuit with one more unit, except those not fitting the array
+  void expand(PartialCircuit const & circuit, propagation::PropagationStats * stats,
+              std::vector<PartialCircuit> * children) const;
+
+  // each step on the first free unit of its type, in a walker on the geometry
+  void build_walker(PartialCircuit const & circuit, Walker * walker) const;
+
+  // score the circuits in the beam and offer them to the best tracker
+  ScoreOutput score_beam();
+
+  // run body(index, stats) for indices in [0, count) on the pool, if any
+  void run_parallel(int count, std::function<void(int, propagation::PropagationStats *)> const & body);
+
+public:
+  BeamSearch(poly_t const & polynomial, scoring::ScoringParams params,
+             Geometry const & geometry = default_geometry());
+
+  /* Grow circuits up to max_units units, or until one recovers the target.
+   * Each unit added is reported like an iteration of StochasticSearch::train.
+   * Returns the best score and how many circuits of the last beam recover
+   * the target.
+   */
+  ScoreOutput search(int max_units);
+
+  void set_beam_width(int width);
+  void set_thread_count(int thread_count);
+  void set_verbose(bool enabled);
+  void set_propagation_limits(propagation::PropagationLimits const & new_limits);
+
+  // see StochasticSearch
+  std::shared_ptr<BestTracker> best_circuits() const { return best_tracker; }
+  void set_best_tracker(std::shared_ptr<BestTracker> tracker);
+  void get_best_walkers(int count, std::vector<Walker> * best, std::vector<double> * best_scores = nullptr);
+};
+
+#endif // BEAMSEARCH_H
@@ -0,0 +1,67 @@
+#include "best_tracker.h"
+
+#include <limits>
+
+using namespace std;
+
+BestTracker::BestTracker(int capacity)
+  : capacity(max(1, capacity)),
+    circuits(make_shared<const vector<BestCircuit>>()),
+    threshold(numeric_limits<double>::lowest()) {
+}
+
+bool BestTracker::would_accept(double score) const {
+  return score > threshold.load(memory_order_acquire);
+}
+
+bool BestTracker::offer(const BestCircuit &candidate) {
+  auto current = snapshot();
+
+  while(true) {
+    if(current->size() == capacity && candidate.score <= current->back().score) {
+      return false;
+    }
+
+    auto updated = make_shared<vector<BestCircuit>>();
+    updated->reserve(min<int>(current->size() + 1, capacity));
+
+    bool inserted = false;
+    for(auto & circuit : *current) {
+      if(circuit.conns == candidate.conns) {
+        // already in, possibly with a different score after a change of limits
+        return false;
+      }
+      if(! inserted && candidate.score > circuit.score) {
+        updated->push_back(candidate);
+        inserted = true;
+      }
+      if(updated->size() < capacity) {
+        updated->push_back(circuit);
+      }
+    }
+    if(! inserted) {
+      if(updated->size() == capacity) {
+        return false;
+      }
+      updated->push_back(candidate);
+    }
+
+    {
+      lock_guard<mutex> guard(lock);
+      if(circuits == current) {
+        circuits = updated;
+        if(updated->size() == capacity) {
+          threshold.store(updated->back().score, memory_order_release);
+        }
+        return true;
+      }
+      // another writer got in first, start over from its list
+      current = circuits;
+    }
+  }
+}
+
+std::shared_ptr<const std::vector<BestCircuit>> BestTracker::snapshot() const {
+  lock_guard<mutex> guard(lock);
+  return circuits;
+}
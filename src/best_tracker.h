@@ -0,0 +1,49 @@
+#ifndef BESTTRACKER_H
+#define BESTTRACKER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "definitions.h"
+
+/* A circuit that made it into the best ones found so far */
+struct BestCircuit {
+  double score;
+  connections_t conns;
+  int wire_length;
+  bool function_recovered;
+};
+
+/* The best distinct circuits found so far, shared between search threads.
+ *
+ * The circuits live in an immutable list, best first, which writers replace
+ * as a whole. A mutex guards the pointer to it, and only the pointer: it is
+ * held to copy or swap it, while writers build the new list outside of it
+ * and start over if another writer swapped first. A snapshot never changes
+ * afterwards. An atomic copy of the lowest score in a full list lets writers
+ * turn most candidates away without taking the mutex at all.
+ */
+class BestTracker {
+  int capacity;
+
+  mutable std::mutex lock;
+  std::shared_ptr<const std::vector<BestCircuit>> circuits;
+
+  // score a candidate must beat to get in
+  std::atomic<double> threshold;
+
+public:
+  BestTracker(int capacity);
+
+  // cheap check, to avoid building candidates that would be turned away
+  bool would_accept(double score) const;
+
+  // add a circuit unless it is already in or not good enough, true if added
+  bool offer(BestCircuit const & candidate);
+
+  // the best circuits at this point, best first
+  std::shared_ptr<const std::vector<BestCircuit>> snapshot() const;
+};
+
+#endif // BESTTRACKER_H
@@ -0,0 +1,77 @@
+#include "checkpoint_writer.h"
+
+using namespace std;
+using namespace serialization;
+
+CheckpointWriter::CheckpointWriter()
+  : has_pending(false),
+    writing(false),
+    stopping(false),
+    written_count(0) {
+  writer = thread(&CheckpointWriter::write_loop, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  // write whatever is still waiting before leaving
+  flush();
+
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  changed.notify_all();
+  writer.join();
+}
+
+void CheckpointWriter::submit(const std::string &path, std::function<void(bytes_t *)> const &encode) {
+  {
+    lock_guard<mutex> guard(lock);
+    pending_path = path;
+    pending_encode = encode;
+    has_pending = true;
+  }
+  changed.notify_all();
+}
+
+void CheckpointWriter::flush() {
+  unique_lock<mutex> guard(lock);
+  changed.wait(guard, [this]() { return ! has_pending && ! writing; });
+}
+
+long CheckpointWriter::count_written() {
+  lock_guard<mutex> guard(lock);
+  return written_count;
+}
+
+void CheckpointWriter::write_loop() {
+  string path;
+  std::function<void(bytes_t *)> encode;
+  bytes_t bytes;
+
+  while(true) {
+    {
+      unique_lock<mutex> guard(lock);
+      changed.wait(guard, [this]() { return stopping || has_pending; });
+      if(! has_pending) {
+        return;
+      }
+
+      path.swap(pending_path);
+      encode.swap(pending_encode);
+      has_pending = false;
+      writing = true;
+    }
+
+    bytes.clear();
+    encode(& bytes);
+    encode = nullptr;
+    bool written = write_file_atomically(path, bytes);
+
+    {
+      lock_guard<mutex> guard(lock);
+      writing = false;
+      written_count += written;
+    }
+    changed.notify_all();
+  }
+}
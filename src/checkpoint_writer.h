@@ -0,0 +1,56 @@
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "serialization.h"
+
+/* Encodes and writes files atomically on a background thread, so that the
+ * thread producing them never waits for the encoding or the disk.
+ *
+ * Only the latest content submitted for writing matters: content that is
+ * still waiting when newer content arrives is dropped without being encoded.
+ */
+class CheckpointWriter {
+  std::thread writer;
+
+  std::mutex lock;
+  std::condition_variable changed;
+
+  // content waiting to be encoded and written
+  std::string pending_path;
+  std::function<void(serialization::bytes_t *)> pending_encode;
+  bool has_pending;
+
+  // true while the writer thread is encoding or writing
+  bool writing;
+  bool stopping;
+
+  // number of files written successfully
+  long written_count;
+
+  void write_loop();
+
+public:
+  CheckpointWriter();
+  ~CheckpointWriter();
+
+  CheckpointWriter(CheckpointWriter const &) = delete;
+  CheckpointWriter & operator=(CheckpointWriter const &) = delete;
+
+  /* Queue content to be written to path, replacing any content still waiting.
+   * encode runs on the writer thread, so it must only capture data that the
+   * caller no longer changes, e.g. copies of walkers.
+   */
+  void submit(std::string const & path, std::function<void(serialization::bytes_t *)> const & encode);
+
+  // wait until all content submitted so far is written
+  void flush();
+
+  long count_written();
+};
+
+#endif // CHECKPOINTWRITER_H
@@ -1 +1,23 @@
 #include "definitions.h"
+
+bool Geometry::has_default_colls() const {
+  for(int coll_id = 0; coll_id < coll_types.size(); ++ coll_id) {
+    if(coll_types[coll_id] != coll_id % 3) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Geometry make_geometry(std::size_t row_count, std::size_t coll_count) {
+  Geometry geometry{row_count, std::vector<int>(coll_count)};
+  for(int coll_id = 0; coll_id < coll_count; ++ coll_id) {
+    geometry.coll_types[coll_id] = coll_id % 3;
+  }
+  return geometry;
+}
+
+Geometry const & default_geometry() {
+  static const Geometry geometry = make_geometry(UNIT_ROW_COUNT, UNIT_COLL_COUNT);
+  return geometry;
+}
@@ -35,6 +35,7 @@
  */
 typedef std::vector<int> connections_t;
 
+// sizes of the default geometry described above
 const std::size_t UNIT_ROW_COUNT = 50;
 const std::size_t UNIT_COLL_COUNT = 3;
 const std::size_t UNIT_COUNT = UNIT_ROW_COUNT * UNIT_COLL_COUNT;
@@ -44,6 +45,79 @@ const std::size_t CONN_INPUT_COUNT = 3 * 50 * 2;
 // last element represents the input of the physical array
 const std::size_t ARRAY_INPUT_ID = CONN_UNIT_COUNT - 1;
 
+/* Geometry of the physical array: the number of rows and the type of the
+ * unit in each column, 0 (adder), 1 (multiplier) or 2 (divider).
+ *
+ * Ids follow the same layout as above for any size: unit_id = row * coll_count + coll
+ * and the input of the array comes right after the last unit.
+ */
+struct Geometry {
+  std::size_t rows;
+  std::vector<int> coll_types;
+
+  std::size_t row_count() const { return rows; }
+  std::size_t coll_count() const { return coll_types.size(); }
+  std::size_t unit_count() const { return rows * coll_types.size(); }
+  std::size_t conn_unit_count() const { return unit_count() + 1; }
+  std::size_t conn_input_count() const { return unit_count() * 2; }
+  int array_input_id() const { return unit_count(); }
+  int unit_type(int unit_id) const { return coll_types[unit_id % coll_types.size()]; }
+
+  // true if the columns repeat the "AMD" pattern
+  bool has_default_colls() const;
+};
+
+inline bool operator==(Geometry const & g1, Geometry const & g2) {
+  return g1.rows == g2.rows && g1.coll_types == g2.coll_types;
+}
+
+inline bool operator!=(Geometry const & g1, Geometry const & g2) {
+  return ! (g1 == g2);
+}
+
+/* Same interface as Geometry for arrays with the default column pattern and
+ * sizes known at compile time, so that loops over units and the row / column
+ * arithmetic can be fully specialized.
+ */
+template<std::size_t RowCount, std::size_t CollCount>
+struct FixedGeometry {
+  static constexpr std::size_t row_count() { return RowCount; }
+  static constexpr std::size_t coll_count() { return CollCount; }
+  static constexpr std::size_t unit_count() { return RowCount * CollCount; }
+  static constexpr std::size_t conn_unit_count() { return unit_count() + 1; }
+  static constexpr std::size_t conn_input_count() { return unit_count() * 2; }
+  static constexpr int array_input_id() { return unit_count(); }
+  static constexpr int unit_type(int unit_id) { return (unit_id % CollCount) % 3; }
+};
+
+// geometry with the given size and the columns repeating the "AMD" pattern
+Geometry make_geometry(std::size_t row_count, std::size_t coll_count);
+
+// the 50 x 3 geometry described above
+Geometry const & default_geometry();
+
+/* Runtime dispatch for code templated on the geometry: calls
+ * Kernel<G>::run(geometry, args...) with a FixedGeometry when the array has
+ * one of the common sizes, and with the generic Geometry otherwise.
+ */
+template<template<typename> class Kernel, typename... Args>
+auto dispatch_geometry(Geometry const & geometry, Args const &... args)
+    -> decltype(Kernel<Geometry>::run(geometry, args...)) {
+  if(geometry.coll_count() == 3 && geometry.has_default_colls()) {
+    switch(geometry.row_count()) {
+    case 50:
+      return Kernel<FixedGeometry<50, 3>>::run(FixedGeometry<50, 3>(), args...);
+    case 100:
+      return Kernel<FixedGeometry<100, 3>>::run(FixedGeometry<100, 3>(), args...);
+    case 200:
+      return Kernel<FixedGeometry<200, 3>>::run(FixedGeometry<200, 3>(), args...);
+    case 400:
+      return Kernel<FixedGeometry<400, 3>>::run(FixedGeometry<400, 3>(), args...);
+    }
+  }
+  return Kernel<Geometry>::run(geometry, args...);
+}
+
 typedef std::vector<int> poly_t;
 
 /* A unit can generate an output, but it does not have to be always valid.
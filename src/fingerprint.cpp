@@ -0,0 +1,118 @@
+#include "fingerprint.h"
+
+#include <iostream>
+
+using namespace std;
+
+// fixed sample points, chosen far from small integers to make collisions unlikely
+static const fingerprint::fingerprint_t SAMPLE_POINTS = {{1234577, 7654337, 104729017, 31415927}};
+
+static uint64_t pow_mod(uint64_t base, uint64_t exponent) {
+  uint64_t result = 1;
+  base %= fingerprint::MODULUS;
+  while(exponent > 0) {
+    if(exponent & 1) {
+      result = result * base % fingerprint::MODULUS;
+    }
+    base = base * base % fingerprint::MODULUS;
+    exponent >>= 1;
+  }
+  return result;
+}
+
+// the modulus is prime, so a^(p - 2) is the inverse of a. Zero maps to zero.
+static uint64_t inverse_mod(uint64_t value) {
+  return pow_mod(value, fingerprint::MODULUS - 2);
+}
+
+fingerprint::fingerprint_t fingerprint::compute_poly_fingerprint(const poly_t &poly) {
+  fingerprint_t values;
+  for(int lane = 0; lane < LANE_COUNT; ++ lane) {
+    uint64_t value = 0;
+    for(int p : poly) {
+      uint64_t term = pow_mod(SAMPLE_POINTS[lane], p >= 0 ? p : -p);
+      if(p < 0) {
+        term = inverse_mod(term);
+      }
+      value = (value + term) % MODULUS;
+    }
+    values[lane] = value;
+  }
+  return values;
+}
+
+fingerprint::fingerprint_t fingerprint::compute_one_unit_fingerprint(int unit_type, const fingerprint_t &in1, const fingerprint_t &in2) {
+  fingerprint_t out;
+
+  switch(unit_type) {
+  case 0: // addition
+    for(int lane = 0; lane < LANE_COUNT; ++ lane) {
+      out[lane] = (in1[lane] + in2[lane]) % MODULUS;
+    }
+    break;
+
+  case 1: // multiplication
+    for(int lane = 0; lane < LANE_COUNT; ++ lane) {
+      out[lane] = in1[lane] * in2[lane] % MODULUS;
+    }
+    break;
+
+  case 2: // division, the symbolic engine decides if the divider is valid
+    for(int lane = 0; lane < LANE_COUNT; ++ lane) {
+      out[lane] = in1[lane] * inverse_mod(in2[lane]) % MODULUS;
+    }
+    break;
+
+  default: // this should never happen
+    cerr << "ERROR: Received unit of invalid type: " << unit_type << endl;
+    out.fill(0);
+  }
+
+  return out;
+}
+
+template<typename G>
+struct UnitFingerprintsKernel {
+  template<typename C>
+  static vector<fingerprint::fingerprint_t> run(G const & geometry, C const & conns, vector<int> const & order) {
+    fingerprint::fingerprint_t zero;
+    zero.fill(0);
+    vector<fingerprint::fingerprint_t> unit_fingerprints(geometry.conn_unit_count(), zero);
+
+    // the input of the array always outputs the polynomial "x"
+    int array_input_id = geometry.array_input_id();
+    unit_fingerprints[array_input_id] = SAMPLE_POINTS;
+
+    for(int unit_id : order) {
+      if(unit_id != array_input_id) {
+        unit_fingerprints[unit_id] = fingerprint::compute_one_unit_fingerprint(
+          geometry.unit_type(unit_id),
+          unit_fingerprints[conns[unit_id * 2]],
+          unit_fingerprints[conns[unit_id * 2 + 1]]
+        );
+      }
+    }
+
+    return unit_fingerprints;
+  }
+};
+
+std::vector<fingerprint::fingerprint_t> fingerprint::compute_unit_fingerprints(const connections_t &conns, const std::vector<int> &order,
+                                                                               const Geometry &geometry) {
+  return dispatch_geometry<UnitFingerprintsKernel>(geometry, conns, order);
+}
+
+std::vector<fingerprint::fingerprint_t> fingerprint::compute_unit_fingerprints(const utils::cow_array<int> &conns, const std::vector<int> &order,
+                                                                               const Geometry &geometry) {
+  return dispatch_geometry<UnitFingerprintsKernel>(geometry, conns, order);
+}
+
+bool fingerprint::has_matching_unit(const std::vector<fingerprint_t> &unit_fingerprints,
+                                    const std::vector<int> &order, const fingerprint_t &target) {
+  for(int unit_id : order) {
+    if(unit_fingerprints[unit_id] == target) {
+      return true;
+    }
+  }
+  return false;
+}
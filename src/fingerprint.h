@@ -0,0 +1,52 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "definitions.h"
+#include "utils/cow_array.h"
+
+/* A second, numeric evaluation engine for circuits.
+ *
+ * Instead of manipulating the powers of each polynomial we propagate the
+ * values the circuit takes at a few fixed sample points, modulo a prime.
+ * Every unit then costs a handful of modular operations, one per lane, and
+ * checking if a unit outputs the target is a handful of compares.
+ *
+ * A polynomial that is equal to the target always has the same fingerprint,
+ * but the reverse does not hold: the numeric engine cannot see invalid
+ * outputs (ex: "2*x" or divisions by several terms) and fingerprints can
+ * collide. A match must therefore be verified symbolically.
+ */
+namespace fingerprint {
+const std::size_t LANE_COUNT = 4;
+
+// 2^31 - 1, small enough that products of two residues fit in 64 bits
+const std::uint64_t MODULUS = 2147483647;
+
+// values at each of the sample points
+typedef std::array<std::uint64_t, LANE_COUNT> fingerprint_t;
+
+// the value of a polynomial at each of the sample points
+fingerprint_t compute_poly_fingerprint(poly_t const & poly);
+
+/* Numeric counterpart of propagation::compute_one_unit_output.
+ * unit_type can be 0 (adder), 1 (multiplier) or 2 (divider)
+ */
+fingerprint_t compute_one_unit_fingerprint(int unit_type, fingerprint_t const & in1, fingerprint_t const & in2);
+
+/* Fingerprints of all unit outputs, following the given propagation order.
+ * Units that are not in the order do not have an output and get a zero fingerprint.
+ */
+std::vector<fingerprint_t> compute_unit_fingerprints(connections_t const & conns, std::vector<int> const & order,
+                                                     Geometry const & geometry = default_geometry());
+std::vector<fingerprint_t> compute_unit_fingerprints(utils::cow_array<int> const & conns, std::vector<int> const & order,
+                                                     Geometry const & geometry);
+
+// true if one of the units in the order outputs a value equal to the target
+bool has_matching_unit(std::vector<fingerprint_t> const & unit_fingerprints,
+                       std::vector<int> const & order, fingerprint_t const & target);
+}
+
+#endif // FINGERPRINT_H
@@ -0,0 +1,121 @@
+#include "island_search.h"
+
+#include <iostream>
+#include <limits>
+#include <iomanip>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+using namespace scoring;
+
+// migration batches an island can have waiting before new ones are dropped
+static const int INBOX_CAPACITY = 4;
+
+// pin the thread to one of the cores the process may run on, wrapping around
+static void pin_to_core(std::thread & island_thread, int island_id) {
+  cpu_set_t allowed;
+  CPU_ZERO(& allowed);
+  if(sched_getaffinity(0, sizeof(allowed), & allowed) != 0 || CPU_COUNT(& allowed) == 0) {
+    return;
+  }
+
+  int position = island_id % CPU_COUNT(& allowed);
+  for(int cpu = 0; cpu < CPU_SETSIZE; ++ cpu) {
+    if(CPU_ISSET(cpu, & allowed) && position-- == 0) {
+      cpu_set_t pinned;
+      CPU_ZERO(& pinned);
+      CPU_SET(cpu, & pinned);
+      if(pthread_setaffinity_np(island_thread.native_handle(), sizeof(pinned), & pinned) != 0) {
+        cerr << "ERROR: Cannot pin island " << island_id << " to core " << cpu << endl;
+      }
+      return;
+    }
+  }
+}
+
+IslandSearch::IslandSearch(const vector<int> &polynomial, int island_count, int walkers_per_island,
+                           ScoringParams params, const Geometry &geometry)
+  : migration{10, 2} {
+  for(int island_id = 0; island_id < island_count; ++ island_id) {
+    islands.emplace_back(new StochasticSearch(polynomial, walkers_per_island, params, geometry));
+    islands.back()->set_verbose(false);
+
+    if(island_id == 0) {
+      best_tracker = islands[0]->best_circuits();
+    } else {
+      islands.back()->set_best_tracker(best_tracker);
+    }
+
+    inbox.emplace_back(new utils::spsc_ring<vector<Walker>>(INBOX_CAPACITY));
+  }
+}
+
+void IslandSearch::set_seed(unsigned seed) {
+  seed_seq seeds{seed};
+  vector<unsigned> island_seeds(islands.size());
+  seeds.generate(island_seeds.begin(), island_seeds.end());
+
+  for(int island_id = 0; island_id < islands.size(); ++ island_id) {
+    islands[island_id]->set_seed(island_seeds[island_id]);
+  }
+}
+
+void IslandSearch::set_migration(const MigrationParams &params) {
+  migration = params;
+}
+
+ScoreOutput IslandSearch::train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise) {
+  island_best.assign(islands.size(), {0, numeric_limits<double>::lowest()});
+
+  vector<thread> threads;
+  for(int island_id = 0; island_id < islands.size(); ++ island_id) {
+    threads.emplace_back(&IslandSearch::train_island, this, island_id,
+                         iteration_count, cycle_count, clone_count, noise);
+    pin_to_core(threads.back(), island_id);
+  }
+  for(auto & island_thread : threads) {
+    island_thread.join();
+  }
+
+  ScoreOutput best = {0, numeric_limits<double>::lowest()};
+  for(int island_id = 0; island_id < islands.size(); ++ island_id) {
+    cout << "Island " << island_id
+         << "\tbest score: " << setprecision(2) << island_best[island_id].best_score
+         << "\tfunction was recovered " << island_best[island_id].times_function_recovered
+         << " times" << endl;
+
+    if(best.best_score < island_best[island_id].best_score) {
+      best = island_best[island_id];
+    }
+  }
+
+  return best;
+}
+
+void IslandSearch::train_island(int island_id, int iteration_count, int cycle_count, int clone_count,
+                                const NoiseParams &noise) {
+  StochasticSearch & search = *islands[island_id];
+  auto & outgoing = *inbox[(island_id + 1) % islands.size()];
+  auto & incoming = *inbox[island_id];
+
+  vector<Walker> migrants;
+  for(int iter_id = 0; iter_id < iteration_count; ++ iter_id) {
+    auto score_out = search.train_iteration(iter_id, iteration_count, cycle_count, clone_count, noise);
+    if(island_best[island_id].best_score < score_out.best_score) {
+      island_best[island_id] = score_out;
+    }
+
+    if(islands.size() < 2 || (iter_id + 1) % migration.interval != 0) {
+      continue;
+    }
+
+    search.get_best_walkers(migration.walker_count, & migrants);
+    outgoing.push(std::move(migrants));
+
+    while(incoming.pop(& migrants)) {
+      search.replace_worst_walkers(migrants);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef ISLANDSEARCH_H
+#define ISLANDSEARCH_H
+
+#include "definitions.h"
+#include "scoring.h"
+#include "stochastic_search.h"
+#include "walker.h"
+#include "best_tracker.h"
+#include "utils/spsc_ring.h"
+#include <memory>
+#include <vector>
+
+struct MigrationParams {
+  // iterations between two migrations
+  int interval;
+
+  // number of walkers each island sends to the next one
+  int walker_count;
+};
+
+/* Island model on top of the stochastic search.
+ *
+ * Each island is an independent StochasticSearch with its own population and
+ * random engine, trained on its own thread. Island threads are pinned to the
+ * cores the process may run on, island i on the i-th of them, wrapping around
+ * when there are more islands than cores, so that each island keeps its
+ * walkers in the caches of one core. Every few iterations an island
+ * sends copies of its best walkers to the next island on a ring, where they
+ * replace the worst ones. Islands never wait for each other: migrants go
+ * through lock-free queues and are dropped when the queue is full.
+ *
+ * Keeping populations apart mostly preserves their diversity, while
+ * migration spreads good partial circuits.
+ */
+class IslandSearch {
+  std::vector<std::unique_ptr<StochasticSearch>> islands;
+
+  // inbox[i] carries migrants from island i - 1 to island i
+  std::vector<std::unique_ptr<utils::spsc_ring<std::vector<Walker>>>> inbox;
+
+  MigrationParams migration;
+
+  // best score of each island over the last call to train
+  std::vector<ScoreOutput> island_best;
+
+  // shared by all islands
+  std::shared_ptr<BestTracker> best_tracker;
+
+  void train_island(int island_id, int iteration_count, int cycle_count, int clone_count,
+                    NoiseParams const & noise);
+
+public:
+  IslandSearch(std::vector<int> const & polynomial, int island_count, int walkers_per_island,
+               scoring::ScoringParams params, Geometry const & geometry = default_geometry());
+
+  int island_count() const { return islands.size(); }
+
+  // access to an island e.g. to configure it before training
+  StochasticSearch & island(int island_id) { return *islands[island_id]; }
+
+  // seeds each island from the given seed, for reproducible runs
+  void set_seed(unsigned seed);
+
+  void set_migration(MigrationParams const & params);
+
+  // train all islands in parallel and return the best score over all of them
+  ScoreOutput train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise);
+
+  std::vector<ScoreOutput> const & best_per_island() const { return island_best; }
+
+  // the best circuits over all islands, see BestTracker
+  std::shared_ptr<BestTracker> best_circuits() const { return best_tracker; }
+};
+
+#endif // ISLANDSEARCH_H
@@ -0,0 +1,189 @@
+#include "island_transport.h"
+#include "serialization.h"
+
+#include <iostream>
+#include <limits>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace scoring;
+using namespace serialization;
+
+// large enough for a batch of a few walkers on big arrays
+static const int MAX_DATAGRAM_SIZE = 1 << 16;
+
+static const uint64_t BEST_WALKER_MAGIC = 0x43504201;
+
+static bool make_address(std::string const & path, sockaddr_un * address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if(path.size() >= sizeof(address->sun_path)) {
+    cerr << "ERROR: Socket path is too long: " << path << endl;
+    return false;
+  }
+  strcpy(address->sun_path, path.c_str());
+  return true;
+}
+
+IslandTransport::IslandTransport(const std::string &directory, int island_id)
+  : directory(directory),
+    island_id(island_id),
+    socket_fd(-1) {
+  sockaddr_un address;
+  if(! make_address(socket_path(island_id), & address)) {
+    return;
+  }
+
+  socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  if(socket_fd == -1) {
+    cerr << "ERROR: Cannot create socket for island " << island_id << endl;
+    return;
+  }
+
+  // a socket left behind by a previous run of the same island
+  unlink(address.sun_path);
+
+  if(bind(socket_fd, (sockaddr *) & address, sizeof(address)) != 0) {
+    cerr << "ERROR: Cannot bind socket: " << address.sun_path << endl;
+    close(socket_fd);
+    socket_fd = -1;
+  }
+}
+
+IslandTransport::~IslandTransport() {
+  if(socket_fd != -1) {
+    close(socket_fd);
+    unlink(socket_path(island_id).c_str());
+  }
+}
+
+std::string IslandTransport::socket_path(int other_island_id) const {
+  return directory + "/island-" + to_string(other_island_id) + ".sock";
+}
+
+bool IslandTransport::send(int other_island_id, const std::vector<Walker> &walkers) {
+  sockaddr_un address;
+  if(socket_fd == -1 || ! make_address(socket_path(other_island_id), & address)) {
+    return false;
+  }
+
+  bytes_t bytes;
+  encode_walkers(walkers, & bytes);
+  if(bytes.size() > MAX_DATAGRAM_SIZE) {
+    return false;
+  }
+
+  ssize_t count = sendto(socket_fd, bytes.data(), bytes.size(), MSG_DONTWAIT,
+                         (sockaddr *) & address, sizeof(address));
+  return count == bytes.size();
+}
+
+bool IslandTransport::receive(std::vector<Walker> *walkers) {
+  if(socket_fd == -1) {
+    return false;
+  }
+
+  bytes_t bytes(MAX_DATAGRAM_SIZE);
+  while(true) {
+    ssize_t count = recv(socket_fd, bytes.data(), bytes.size(), MSG_DONTWAIT);
+    if(count < 0) {
+      return false;
+    }
+
+    bytes.resize(count);
+    if(decode_walkers(bytes, walkers)) {
+      return true;
+    }
+
+    // skip batches that do not decode
+    bytes.resize(MAX_DATAGRAM_SIZE);
+  }
+}
+
+ProcessIsland::ProcessIsland(const std::vector<int> &polynomial, int walker_count, ScoringParams params,
+                             const std::string &directory, int island_id, int island_count,
+                             const Geometry &geometry)
+  : geometry(geometry),
+    search(polynomial, walker_count, params, geometry),
+    transport(directory, island_id),
+    directory(directory),
+    island_id(island_id),
+    island_count(island_count),
+    migration{10, 2},
+    best{0, numeric_limits<double>::lowest()},
+    saved_score(numeric_limits<double>::lowest()) {
+  search.set_verbose(false);
+
+  // a restarted island only replaces the circuit of its previous run with a better one
+  Walker saved;
+  load_best_walker(best_walker_path(), & saved, & saved_score);
+}
+
+void ProcessIsland::set_migration(const MigrationParams &params) {
+  migration = params;
+}
+
+std::string ProcessIsland::best_walker_path() const {
+  return directory + "/island-" + to_string(island_id) + ".best";
+}
+
+ScoreOutput ProcessIsland::train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise) {
+  vector<Walker> migrants;
+  for(int iter_id = 0; iter_id < iteration_count; ++ iter_id) {
+    auto score_out = search.train_iteration(iter_id, iteration_count, cycle_count, clone_count, noise);
+
+    if(best.best_score < score_out.best_score) {
+      best = score_out;
+    }
+
+    if(island_count > 1 && (iter_id + 1) % migration.interval == 0) {
+      search.get_best_walkers(migration.walker_count, & migrants);
+      transport.send((island_id + 1) % island_count, migrants);
+
+      while(transport.receive(& migrants)) {
+        search.replace_worst_walkers(migrants);
+      }
+    }
+
+    // the iteration ends with noise, so the walkers may no longer be the
+    // circuits that were scored, the tracker keeps those
+    auto circuits = search.best_circuits()->snapshot();
+    if(! circuits->empty() && saved_score < circuits->front().score) {
+      saved_score = circuits->front().score;
+      save_best_walker(best_walker_path(), Walker(geometry, circuits->front().conns), saved_score);
+    }
+  }
+
+  return best;
+}
+
+bool save_best_walker(const std::string &path, const Walker &walker, double score) {
+  bytes_t bytes;
+  put_varint(BEST_WALKER_MAGIC, & bytes);
+  put_double(score, & bytes);
+  encode_walker(walker, & bytes);
+  return write_file_atomically(path, bytes);
+}
+
+bool load_best_walker(const std::string &path, Walker *walker, double *score) {
+  bytes_t bytes;
+  size_t offset = 0;
+  uint64_t magic = 0;
+  double saved_score = 0;
+  Walker saved;
+  if(! read_file(path, & bytes) ||
+     ! get_varint(bytes, & offset, & magic) || magic != BEST_WALKER_MAGIC ||
+     ! get_double(bytes, & offset, & saved_score) ||
+     ! decode_walker(bytes, & offset, & saved) || offset != bytes.size()) {
+    return false;
+  }
+
+  *walker = std::move(saved);
+  if(score) {
+    *score = saved_score;
+  }
+  return true;
+}
@@ -0,0 +1,93 @@
+#ifndef ISLANDTRANSPORT_H
+#define ISLANDTRANSPORT_H
+
+#include <string>
+#include <vector>
+#include "definitions.h"
+#include "scoring.h"
+#include "stochastic_search.h"
+#include "island_search.h"
+#include "walker.h"
+
+/* Exchange of walkers between islands running in separate processes on the
+ * same machine.
+ *
+ * Each island binds a Unix datagram socket named after its id in a directory
+ * shared by all islands, and sends batches of walkers to the sockets of the
+ * others, in the binary encoding of serialization::encode_walkers. Sending
+ * and receiving never block: batches to islands that are busy, not started
+ * yet or gone are dropped, as are batches that do not decode.
+ */
+class IslandTransport {
+  std::string directory;
+  int island_id;
+  int socket_fd;
+
+public:
+  IslandTransport(std::string const & directory, int island_id);
+  ~IslandTransport();
+
+  IslandTransport(IslandTransport const &) = delete;
+  IslandTransport & operator=(IslandTransport const &) = delete;
+
+  // false if the socket could not be bound, in which case nothing is sent or received
+  bool is_open() const { return socket_fd != -1; }
+
+  std::string socket_path(int other_island_id) const;
+
+  // false if the batch was not handed over to the socket of the other island
+  bool send(int other_island_id, std::vector<Walker> const & walkers);
+
+  // the next batch received, false if there is none
+  bool receive(std::vector<Walker> * walkers);
+};
+
+/* One island of a search spread over several processes, each running one of
+ * them with the same directory, island count and parameters but a distinct id.
+ *
+ * Migration follows IslandSearch: every few iterations the best walkers go to
+ * the next island on the ring and replace the worst ones there. After each
+ * iteration, if the best circuit the island has scored beats the one saved
+ * so far, it is written to a file in the directory as a walker with its
+ * score, atomically, so that it survives the process. Circuits are taken from
+ * the best tracker as they were scored, before the noise that ends each
+ * iteration. An island restarted on the same directory and id starts from the
+ * score in that file, so it never replaces the circuit with a worse one.
+ */
+class ProcessIsland {
+  Geometry geometry;
+  StochasticSearch search;
+  IslandTransport transport;
+
+  std::string directory;
+  int island_id;
+  int island_count;
+  MigrationParams migration;
+
+  ScoreOutput best;
+
+  // score of the circuit in the best walker file
+  double saved_score;
+
+public:
+  ProcessIsland(std::vector<int> const & polynomial, int walker_count, scoring::ScoringParams params,
+                std::string const & directory, int island_id, int island_count,
+                Geometry const & geometry = default_geometry());
+
+  StochasticSearch & island() { return search; }
+
+  void set_migration(MigrationParams const & params);
+
+  // train the island and return its best score
+  ScoreOutput train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise);
+
+  std::string best_walker_path() const;
+};
+
+// the best walker of an island behind its own magic number and its score
+bool save_best_walker(std::string const & path, Walker const & walker, double score);
+
+// read back the best walker saved by an island and its score, false if there is none
+bool load_best_walker(std::string const & path, Walker * walker, double * score = nullptr);
+
+#endif // ISLANDTRANSPORT_H
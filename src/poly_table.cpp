@@ -0,0 +1,284 @@
+#include "poly_table.h"
+#include "serialization.h"
+#include "utils/work_stealing_pool.h"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <tuple>
+
+using namespace std;
+using namespace propagation;
+using namespace serialization;
+
+// "CPT" and the version of the table format
+static const uint64_t POLY_TABLE_MAGIC = 0x43505401;
+
+// entries of the previous layer per task when building on several threads
+static const int BUILD_CHUNK_SIZE = 4;
+
+PolyTable::PolyTable()
+  : limits(DEFAULT_LIMITS),
+    max_depth(0) {
+}
+
+void PolyTable::build(const PropagationLimits &limits, int max_depth, int thread_count) {
+  this->limits = limits;
+  this->max_depth = max_depth;
+
+  entries.clear();
+  index.clear();
+  entries.push_back({{1}, 0, 0, -1, -1, -1});
+  index[{1}] = 0;
+
+  unique_ptr<utils::work_stealing_pool> pool;
+  if(thread_count > 1) {
+    pool.reset(new utils::work_stealing_pool(thread_count));
+  }
+
+  // entries found in the previous layer
+  int layer_begin = 0;
+  int layer_end = 1;
+
+  for(int depth = 1; depth <= max_depth && layer_begin < layer_end; ++ depth) {
+    // cheapest construction of each output per thread, against the entries so far
+    vector<map<poly_t, PolyEntry>> found(pool ? pool->size() : 1);
+
+    auto combine = [&](int unit_type, int operand1, int operand2, int thread_id) {
+      UnitOutput in1 {true, true, entries[operand1].poly};
+      UnitOutput in2 {true, true, entries[operand2].poly};
+      UnitOutput out = compute_one_unit_output(unit_type, in1, in2, limits);
+      if(! out.has_output || ! out.is_valid) {
+        return;
+      }
+
+      // both inputs on the same unit only need it once
+      int tree_unit_count = entries[operand1].tree_unit_count + 1;
+      if(operand2 != operand1) {
+        tree_unit_count += entries[operand2].tree_unit_count;
+      }
+
+      auto known = index.find(out.poly);
+      if(known != index.end() && entries[known->second].tree_unit_count <= tree_unit_count) {
+        return;
+      }
+      auto & best = found[thread_id][out.poly];
+      if(best.poly.empty() || tree_unit_count < best.tree_unit_count) {
+        best = {out.poly, depth, tree_unit_count, unit_type, operand1, operand2};
+      }
+    };
+
+    auto combine_layer = [&](int begin, int end, int thread_id) {
+      for(int operand1 = layer_begin + begin; operand1 < layer_begin + end; ++ operand1) {
+        for(int operand2 = 0; operand2 < layer_end; ++ operand2) {
+          // adders and multipliers commute, pairs within the layer come up twice
+          bool in_layer = operand2 >= layer_begin;
+          if(! in_layer || operand2 <= operand1) {
+            combine(0, operand1, operand2, thread_id);
+            combine(1, operand1, operand2, thread_id);
+          }
+          combine(2, operand1, operand2, thread_id);
+          if(! in_layer) {
+            combine(2, operand2, operand1, thread_id);
+          }
+        }
+      }
+    };
+
+    if(pool) {
+      pool->parallel_for(layer_end - layer_begin, BUILD_CHUNK_SIZE, combine_layer);
+    } else {
+      combine_layer(0, layer_end - layer_begin, 0);
+    }
+
+    // merge in a fixed order: by polynomial, then by cost and construction
+    vector<PolyEntry> candidates;
+    for(auto & thread_found : found) {
+      for(auto & candidate : thread_found) {
+        candidates.push_back(std::move(candidate.second));
+      }
+    }
+    sort(candidates.begin(), candidates.end(), [](PolyEntry const & e1, PolyEntry const & e2) {
+      if(e1.poly != e2.poly) {
+        return e1.poly < e2.poly;
+      }
+      if(e1.tree_unit_count != e2.tree_unit_count) {
+        return e1.tree_unit_count < e2.tree_unit_count;
+      }
+      return make_tuple(e1.unit_type, e1.operand1, e1.operand2) <
+             make_tuple(e2.unit_type, e2.operand1, e2.operand2);
+    });
+
+    layer_begin = entries.size();
+    for(auto & candidate : candidates) {
+      auto known = index.find(candidate.poly);
+      if(known == index.end()) {
+        index[candidate.poly] = entries.size();
+        entries.push_back(std::move(candidate));
+      } else if(candidate.tree_unit_count < entries[known->second].tree_unit_count) {
+        // a cheaper way to an older entry, which keeps its depth
+        auto & entry = entries[known->second];
+        entry.tree_unit_count = candidate.tree_unit_count;
+        entry.unit_type = candidate.unit_type;
+        entry.operand1 = candidate.operand1;
+        entry.operand2 = candidate.operand2;
+      }
+    }
+    layer_end = entries.size();
+  }
+}
+
+PolyEntry const * PolyTable::find(const poly_t &poly) const {
+  poly_t canonical = poly;
+  sort_canonical(& canonical);
+
+  auto found = index.find(canonical);
+  return found == index.end() ? nullptr : & entries[found->second];
+}
+
+bool PolyTable::build_walker(const poly_t &poly, Walker *walker) const {
+  PolyEntry const * target = find(poly);
+  if(target == nullptr) {
+    return false;
+  }
+
+  Geometry const & geometry = walker->geometry();
+  walker->reset();
+
+  // next unit to look at for each type, units are taken in id order
+  vector<int> next_unit(3, 0);
+  vector<int> placed(entries.size(), -1);
+  placed[0] = geometry.array_input_id();
+
+  function<int(int)> place = [&](int entry_id) {
+    if(placed[entry_id] != -1) {
+      return placed[entry_id];
+    }
+    auto & entry = entries[entry_id];
+    int unit1 = place(entry.operand1);
+    int unit2 = place(entry.operand2);
+    if(unit1 == -1 || unit2 == -1) {
+      return -1;
+    }
+
+    int & unit_id = next_unit[entry.unit_type];
+    while(unit_id < (int) geometry.unit_count() && geometry.unit_type(unit_id) != entry.unit_type) {
+      ++ unit_id;
+    }
+    if(unit_id == (int) geometry.unit_count()) {
+      return -1;
+    }
+
+    walker->rewire(unit_id * 2, unit1);
+    walker->rewire(unit_id * 2 + 1, unit2);
+    placed[entry_id] = unit_id ++;
+    return placed[entry_id];
+  };
+
+  if(place(target - entries.data()) == -1) {
+    walker->reset();
+    return false;
+  }
+  return true;
+}
+
+bool PolyTable::save(const std::string &path) const {
+  bytes_t bytes;
+  put_varint(POLY_TABLE_MAGIC, & bytes);
+  put_varint(limits.max_degree, & bytes);
+  put_varint(limits.max_terms, & bytes);
+  put_varint(max_depth, & bytes);
+  put_varint(entries.size(), & bytes);
+
+  for(auto & entry : entries) {
+    // powers are in decreasing order, so each one is stored as the step down
+    put_varint(entry.poly.size(), & bytes);
+    int previous = 0;
+    for(int pos = 0; pos < entry.poly.size(); ++ pos) {
+      put_varint(pos == 0 ? entry.poly[pos] : previous - entry.poly[pos], & bytes);
+      previous = entry.poly[pos];
+    }
+    put_varint(entry.depth, & bytes);
+    put_varint(entry.tree_unit_count, & bytes);
+    put_varint(entry.unit_type + 1, & bytes);
+    put_varint(entry.operand1 + 1, & bytes);
+    put_varint(entry.operand2 + 1, & bytes);
+  }
+
+  return write_file_atomically(path, bytes);
+}
+
+bool PolyTable::load(const std::string &path) {
+  bytes_t bytes;
+  size_t offset = 0;
+  uint64_t magic = 0;
+  uint64_t max_degree = 0;
+  uint64_t max_terms = 0;
+  uint64_t depth_limit = 0;
+  uint64_t entry_count = 0;
+  if(! read_file(path, & bytes) ||
+     ! get_varint(bytes, & offset, & magic) || magic != POLY_TABLE_MAGIC ||
+     ! get_varint(bytes, & offset, & max_degree) || ! get_varint(bytes, & offset, & max_terms) ||
+     ! get_varint(bytes, & offset, & depth_limit) || ! get_varint(bytes, & offset, & entry_count) ||
+     entry_count == 0 || entry_count > bytes.size()) {
+    cerr << "ERROR: Cannot read polynomial table: " << path << endl;
+    return false;
+  }
+
+  vector<PolyEntry> loaded(entry_count);
+  map<poly_t, int> loaded_index;
+  bool valid = true;
+  for(int entry_id = 0; entry_id < entry_count && valid; ++ entry_id) {
+    auto & entry = loaded[entry_id];
+    uint64_t term_count = 0;
+    valid = get_varint(bytes, & offset, & term_count) && term_count > 0 && term_count <= max_terms;
+
+    int previous = 0;
+    for(uint64_t term = 0; term < term_count && valid; ++ term) {
+      uint64_t value = 0;
+      valid = get_varint(bytes, & offset, & value) && value > 0 && value <= max_degree;
+      previous = term == 0 ? value : previous - value;
+      entry.poly.push_back(previous);
+    }
+
+    // depth, tree unit count, unit type, then the operands
+    uint64_t values[5];
+    uint64_t bounds[5] = {depth_limit, 1u << 30, 3, entry_count, entry_count};
+    for(int pos = 0; pos < 5 && valid; ++ pos) {
+      valid = get_varint(bytes, & offset, & values[pos]) && values[pos] <= bounds[pos];
+    }
+    if(! valid) {
+      break;
+    }
+    entry.depth = values[0];
+    entry.tree_unit_count = values[1];
+    entry.unit_type = (int) values[2] - 1;
+    entry.operand1 = (int) values[3] - 1;
+    entry.operand2 = (int) values[4] - 1;
+    valid = entry.poly.back() > 0 && loaded_index.insert({entry.poly, entry_id}).second;
+  }
+
+  // every construction must lead back to x, through cheaper entries
+  for(int entry_id = 0; entry_id < entry_count && valid; ++ entry_id) {
+    auto & entry = loaded[entry_id];
+    if(entry_id == 0) {
+      valid = entry.poly == poly_t {1} && entry.unit_type == -1;
+    } else {
+      valid = entry.unit_type >= 0 && entry.operand1 >= 0 && entry.operand2 >= 0 &&
+          loaded[entry.operand1].tree_unit_count < entry.tree_unit_count &&
+          loaded[entry.operand2].tree_unit_count < entry.tree_unit_count;
+    }
+  }
+
+  if(! valid || offset != bytes.size()) {
+    cerr << "ERROR: Invalid polynomial table: " << path << endl;
+    return false;
+  }
+
+  limits = {(int) max_degree, (int) max_terms};
+  max_depth = depth_limit;
+  entries = std::move(loaded);
+  index = std::move(loaded_index);
+  return true;
+}
@@ -0,0 +1,74 @@
+#ifndef POLYTABLE_H
+#define POLYTABLE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "definitions.h"
+#include "propagation.h"
+#include "walker.h"
+
+/* How each polynomial in canonical order is built out of x, or of an
+ * operand that is itself in the table.
+ */
+struct PolyEntry {
+  poly_t poly;
+
+  // minimal number of units on the longest path from x, which is also a
+  // lower bound on the number of units of any circuit producing poly
+  int depth;
+
+  // units of the cheapest construction found, counted as a tree: an operand
+  // used on several paths counts once per path, so circuits that share it,
+  // like those of build_walker, can need fewer units
+  int tree_unit_count;
+
+  // type of the last unit, see propagation::compute_one_unit_output, and the
+  // indices of the entries on its inputs, where entry 0 is x itself; -1 for x
+  int unit_type;
+  int operand1;
+  int operand2;
+};
+
+/* Every valid polynomial reachable from x within the given limits and
+ * number of unit layers, found bottom-up one layer at a time: layer d
+ * holds the outputs of an adder, multiplier or divider whose inputs come
+ * from layers below d, one of them from d - 1. Outputs follow the rules of
+ * compute_one_unit_output, so the table agrees with what the array computes.
+ *
+ * The pairs of each layer are combined on several threads and merged in a
+ * fixed order, so the table only depends on the limits.
+ */
+class PolyTable {
+  propagation::PropagationLimits limits;
+  int max_depth;
+
+  // entry 0 is x, then the others in the order they were found
+  std::vector<PolyEntry> entries;
+  std::map<poly_t, int> index;
+
+public:
+  PolyTable();
+
+  void build(propagation::PropagationLimits const & limits, int max_depth, int thread_count = 1);
+
+  std::size_t size() const { return entries.size(); }
+  std::vector<PolyEntry> const & all_entries() const { return entries; }
+
+  // the entry of the polynomial in any order of its powers, null if it is not reachable
+  PolyEntry const * find(poly_t const & poly) const;
+
+  /* Wire the construction of the polynomial into an empty walker, each unit
+   * on the first free unit of its type. False if the polynomial is not in
+   * the table or the array has too few units of some type.
+   */
+  bool build_walker(poly_t const & poly, Walker * walker) const;
+
+  /* Compact binary encoding: the limits, then each entry with its powers
+   * delta coded, all as varints.
+   */
+  bool save(std::string const & path) const;
+  bool load(std::string const & path);
+};
+
+#endif // POLYTABLE_H
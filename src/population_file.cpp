@@ -0,0 +1,217 @@
+#include "population_file.h"
+
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// "CPP" and the version of the file layout
+static const uint32_t POPULATION_MAGIC = 0x43505002;
+
+// records start on a cache line boundary after the header and column types
+static const size_t RECORDS_ALIGNMENT = 64;
+
+struct PopulationHeader {
+  uint32_t magic;
+  uint32_t id_size;
+  int32_t iteration;
+  int32_t iteration_count;
+  uint64_t row_count;
+  uint64_t coll_count;
+  uint64_t walker_count;
+};
+
+static const size_t ITERATION_OFFSET = offsetof(PopulationHeader, iteration);
+static const size_t ITERATION_COUNT_OFFSET = offsetof(PopulationHeader, iteration_count);
+
+PopulationFile::PopulationFile()
+  : fd(-1),
+    mapping(nullptr),
+    mapping_size(0),
+    walker_count(0),
+    id_size(1),
+    record_size(0),
+    records_offset(0),
+    restored(false) {
+}
+
+PopulationFile::~PopulationFile() {
+  close();
+}
+
+bool PopulationFile::open(const std::string &path, const Geometry &geometry, std::size_t walker_count) {
+  close();
+
+  this->path = path;
+  this->geometry = geometry;
+  this->walker_count = walker_count;
+
+  // one byte per input as long as the ids and the "not connected" value fit,
+  // two bytes up to the same limit
+  if(geometry.conn_unit_count() >= 0xffff) {
+    cerr << "ERROR: Too many units for a population file: " << geometry.unit_count() << endl;
+    return false;
+  }
+  id_size = geometry.conn_unit_count() < 0xff ? 1 : 2;
+  record_size = geometry.conn_input_count() * id_size;
+  records_offset = sizeof(PopulationHeader) + geometry.coll_count();
+  records_offset = (records_offset + RECORDS_ALIGNMENT - 1) / RECORDS_ALIGNMENT * RECORDS_ALIGNMENT;
+  size_t file_size = records_offset + walker_count * record_size;
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat file_stat;
+  if(fd == -1 || fstat(fd, & file_stat) != 0) {
+    cerr << "ERROR: Cannot open population file: " << path << endl;
+    close();
+    return false;
+  }
+
+  // keep the records of an earlier run, a file that holds another population
+  // is left alone rather than overwritten
+  PopulationHeader header;
+  restored = file_stat.st_size != 0;
+  if(restored && ! ((size_t) file_stat.st_size == file_size &&
+                    pread(fd, & header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+                    header.magic == POPULATION_MAGIC && header.id_size == id_size &&
+                    header.row_count == geometry.rows && header.coll_count == geometry.coll_count() &&
+                    header.walker_count == walker_count)) {
+    cerr << "ERROR: Population file holds another population: " << path << endl;
+    close();
+    return false;
+  }
+
+  if(! restored && ftruncate(fd, file_size) != 0) {
+    cerr << "ERROR: Cannot resize population file: " << path << endl;
+    close();
+    return false;
+  }
+
+  void * address = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(address == MAP_FAILED) {
+    cerr << "ERROR: Cannot map population file: " << path << endl;
+    close();
+    return false;
+  }
+  mapping = static_cast<uint8_t *>(address);
+  mapping_size = file_size;
+
+  uint8_t * coll_types = mapping + sizeof(PopulationHeader);
+  if(restored) {
+    for(size_t coll = 0; coll < geometry.coll_count(); ++ coll) {
+      if(coll_types[coll] != geometry.coll_types[coll]) {
+        cerr << "ERROR: Population file holds another population: " << path << endl;
+        close();
+        return false;
+      }
+    }
+  }
+
+  if(! restored) {
+    header = PopulationHeader {POPULATION_MAGIC, (uint32_t) id_size, 0, 0,
+                               geometry.rows, geometry.coll_count(), walker_count};
+    memcpy(mapping, & header, sizeof(header));
+    for(size_t coll = 0; coll < geometry.coll_count(); ++ coll) {
+      coll_types[coll] = geometry.coll_types[coll];
+    }
+    // all bytes set is "not connected" for either id size
+    memset(mapping + records_offset, 0xff, walker_count * record_size);
+  }
+
+  return true;
+}
+
+void PopulationFile::close() {
+  if(mapping != nullptr) {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+  }
+  if(fd != -1) {
+    ::close(fd);
+    fd = -1;
+  }
+  restored = false;
+}
+
+int PopulationFile::iteration() const {
+  int32_t iteration = 0;
+  memcpy(& iteration, mapping + ITERATION_OFFSET, sizeof(iteration));
+  return iteration;
+}
+
+int PopulationFile::iteration_count() const {
+  int32_t iteration_count = 0;
+  memcpy(& iteration_count, mapping + ITERATION_COUNT_OFFSET, sizeof(iteration_count));
+  return iteration_count;
+}
+
+void PopulationFile::set_iteration(int iteration, int iteration_count) {
+  int32_t value = iteration;
+  memcpy(mapping + ITERATION_OFFSET, & value, sizeof(value));
+  value = iteration_count;
+  memcpy(mapping + ITERATION_COUNT_OFFSET, & value, sizeof(value));
+}
+
+void PopulationFile::store(std::size_t walker_id, const Walker &walker) {
+  uint8_t * data = record(walker_id);
+  size_t input_count = geometry.conn_input_count();
+
+  if(id_size == 1) {
+    for(size_t input_id = 0; input_id < input_count; ++ input_id) {
+      data[input_id] = (uint8_t) walker.input(input_id);
+    }
+  } else {
+    for(size_t input_id = 0; input_id < input_count; ++ input_id) {
+      uint16_t unit_id = (uint16_t) walker.input(input_id);
+      memcpy(data + input_id * 2, & unit_id, sizeof(unit_id));
+    }
+  }
+}
+
+bool PopulationFile::load(std::size_t walker_id, Walker *walker) const {
+  if(walker->geometry() != geometry) {
+    *walker = Walker(geometry);
+  } else {
+    walker->reset();
+  }
+
+  const uint8_t * data = record(walker_id);
+  int not_connected = id_size == 1 ? 0xff : 0xffff;
+  for(size_t input_id = 0; input_id < geometry.conn_input_count(); ++ input_id) {
+    int unit_id = 0;
+    if(id_size == 1) {
+      unit_id = data[input_id];
+    } else {
+      uint16_t value = 0;
+      memcpy(& value, data + input_id * 2, sizeof(value));
+      unit_id = value;
+    }
+
+    if(unit_id == not_connected) {
+      continue;
+    }
+    if(unit_id >= (int) geometry.conn_unit_count()) {
+      walker->reset();
+      return false;
+    }
+    walker->rewire(input_id, unit_id);
+  }
+  return true;
+}
+
+void PopulationFile::advise_sequential() {
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+}
+
+bool PopulationFile::sync() {
+  if(msync(mapping, mapping_size, MS_SYNC) != 0) {
+    cerr << "ERROR: Cannot sync population file: " << path << endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,81 @@
+#ifndef POPULATIONFILE_H
+#define POPULATIONFILE_H
+
+#include <cstdint>
+#include <string>
+#include "definitions.h"
+#include "walker.h"
+
+/* A population of walkers kept in a memory mapped file of fixed size records,
+ * so that it survives the process.
+ *
+ * Each record holds the unit id of every input of one walker, as one byte
+ * when the ids of the array fit (the default 50 x 3 array does) and as two
+ * bytes otherwise, with the largest value meaning "not connected". Arrays
+ * with ids that do not fit in two bytes are rejected. A header with the
+ * geometry, the number of records and how far the run that stored them got
+ * comes first, in the byte order of the host: the file is meant to be
+ * reopened on the same machine.
+ *
+ * Writes go to the mapping directly, so making the population durable is
+ * a single sync() of the mapping.
+ */
+class PopulationFile {
+  std::string path;
+  int fd;
+
+  uint8_t * mapping;
+  std::size_t mapping_size;
+
+  Geometry geometry;
+  std::size_t walker_count;
+  std::size_t id_size;
+  std::size_t record_size;
+  std::size_t records_offset;
+
+  // true if open found the records of an earlier run
+  bool restored;
+
+  uint8_t * record(std::size_t walker_id) const {
+    return mapping + records_offset + walker_id * record_size;
+  }
+
+public:
+  PopulationFile();
+  ~PopulationFile();
+
+  PopulationFile(PopulationFile const &) = delete;
+  PopulationFile & operator=(PopulationFile const &) = delete;
+
+  /* Map the file at path for walker_count walkers on the geometry. An
+   * existing file with the same geometry and walker count is kept as is, a
+   * new or empty one starts with empty walkers. False if the file holds any
+   * other population, which is left untouched.
+   */
+  bool open(std::string const & path, Geometry const & geometry, std::size_t walker_count);
+  void close();
+
+  bool is_open() const { return mapping != nullptr; }
+  bool was_restored() const { return restored; }
+  std::size_t size() const { return walker_count; }
+
+  // the number of iterations the stored population went through, out of
+  // the iteration count of the run that stored it
+  int iteration() const;
+  int iteration_count() const;
+  void set_iteration(int iteration, int iteration_count);
+
+  // copy the connections of a walker on the same geometry into its record
+  void store(std::size_t walker_id, Walker const & walker);
+
+  // rebuild a walker from its record, false if the record is invalid
+  bool load(std::size_t walker_id, Walker * walker) const;
+
+  // tell the kernel the records are about to be swept in order
+  void advise_sequential();
+
+  // write the dirty pages of the mapping to disk and wait for it
+  bool sync();
+};
+
+#endif // POPULATIONFILE_H
@@ -2,15 +2,101 @@
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <set>
 
 using namespace std;
+using namespace propagation;
 
 void propagation::sort_canonical(std::vector<int> *p) {
   sort(p->begin(), p->end(), std::greater<int>());
 }
 
-UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput &in1, const UnitOutput &in2) {
+bool propagation::add_canonical(const poly_t &p1, const poly_t &p2, poly_t *sum) {
+  sum->clear();
+  sum->reserve(p1.size() + p2.size());
+
+  // standard merge, both inputs are in descending order
+  int i1 = 0;
+  int i2 = 0;
+  while(i1 < p1.size() && i2 < p2.size()) {
+    if(p1[i1] > p2[i2]) {
+      sum->push_back(p1[i1 ++]);
+    } else if(p1[i1] < p2[i2]) {
+      sum->push_back(p2[i2 ++]);
+    } else {
+      // duplicate power i.e. a polynomial of the form "2*x" which is invalid
+      return false;
+    }
+  }
+  sum->insert(sum->end(), p1.begin() + i1, p1.end());
+  sum->insert(sum->end(), p2.begin() + i2, p2.end());
+
+  return true;
+}
+
+bool propagation::multiply_canonical(const poly_t &p1, const poly_t &p2, poly_t *product) {
+  product->clear();
+  product->reserve(p1.size() * p2.size());
+
+  // merge the rows p1[i] + p2[j], each of them already in descending order
+  const poly_t & rows = p1.size() <= p2.size() ? p1 : p2;
+  const poly_t & cols = p1.size() <= p2.size() ? p2 : p1;
+
+  // heap of (head of the row, row index) and the position reached in each row
+  vector<pair<int, int>> heap;
+  vector<int> row_pos(rows.size(), 0);
+  heap.reserve(rows.size());
+  for(int row_id = 0; row_id < rows.size(); ++ row_id) {
+    heap.push_back({rows[row_id] + cols[0], row_id});
+  }
+  make_heap(heap.begin(), heap.end());
+
+  while(! heap.empty()) {
+    pop_heap(heap.begin(), heap.end());
+    int power = heap.back().first;
+    int row_id = heap.back().second;
+
+    // duplicate power i.e. a polynomial of the form "2*x" which is invalid
+    if(! product->empty() && product->back() == power) {
+      return false;
+    }
+    product->push_back(power);
+
+    // advance the row we just consumed
+    int col_id = ++ row_pos[row_id];
+    if(col_id < cols.size()) {
+      heap.back().first = rows[row_id] + cols[col_id];
+      push_heap(heap.begin(), heap.end());
+    } else {
+      heap.pop_back();
+    }
+  }
+
+  return true;
+}
+
+// check the size of an output before materializing it, counting the limit that fired
+static bool exceeds_limits(long long degree, long long term_count,
+                           const PropagationLimits &limits,
+                           PropagationStats *stats) {
+  if(degree > limits.max_degree) {
+    if(stats) {
+      ++ stats->degree_limit_hits;
+    }
+    return true;
+  }
+  if(term_count > limits.max_terms) {
+    if(stats) {
+      ++ stats->term_limit_hits;
+    }
+    return true;
+  }
+  return false;
+}
+
+UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput &in1, const UnitOutput &in2,
+                                                const PropagationLimits &limits, PropagationStats *stats) {
   if(! in1.has_output || ! in2.has_output) {
     // if an input does not have a signal flowing through it then do not propagate
     // this should never happen btw
@@ -23,23 +109,33 @@ UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput
 
   vector<int> poly;
 
+  // inputs are in canonical form, so their highest powers are at the front
+  long long degree1 = in1.poly.front();
+  long long degree2 = in2.poly.front();
+
   // implement polynomial addition, multiplication and division
   switch(unit_type) {
 
-  case 0: // addition -- just concat all terms
-    // copy of the first polynomial
-    poly = in1.poly;
-    for(int p : in2.poly) {
-      poly.push_back(p);
+  case 0: // addition -- merge the terms of both polynomials
+    if(exceeds_limits(max(degree1, degree2),
+                      (long long) in1.poly.size() + in2.poly.size(), limits, stats)) {
+      return {true, false, {}};
+    }
+
+    if(! add_canonical(in1.poly, in2.poly, & poly)) {
+      return {true, false, {}};
     }
     break;
 
   case 1: // multiplication
-    poly.reserve(in1.poly.size() + in2.poly.size());
-    for(int p1 : in1.poly) {
-      for(int p2 : in2.poly) {
-        poly.push_back(p1 + p2);
-      }
+    // the product has n * m terms unless some of them collide, which is invalid anyway
+    if(exceeds_limits(degree1 + degree2,
+                      (long long) in1.poly.size() * in2.poly.size(), limits, stats)) {
+      return {true, false, {}};
+    }
+
+    if(! multiply_canonical(in1.poly, in2.poly, & poly)) {
+      return {true, false, {}};
     }
     break;
 
@@ -49,7 +145,12 @@ UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput
     } else {
       int divider = in2.poly[0];
 
-      // copy of the first polynomial
+      if(exceeds_limits(degree1 - divider, in1.poly.size(), limits, stats)) {
+        return {true, false, {}};
+      }
+
+      // copy of the first polynomial; shifting all powers keeps the order
+      // and cannot create duplicates
       poly = in1.poly;
 
       for(int& p : poly) {
@@ -63,15 +164,6 @@ UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput
     return {true, false, {}};
   }
 
-  sort_canonical(& poly);
-
-  // check for duplicate powers i.e. a polynomial of the form "2*x" which is invalid
-  for(int pid = 1; pid < poly.size(); ++ pid) {
-    if(poly[pid - 1] == poly[pid]) {
-      return {true, false, {}};
-    }
-  }
-
   // check for negative powers
   if(poly.back() <= 0) {
     return {true, false, {}};
@@ -80,23 +172,213 @@ UnitOutput propagation::compute_one_unit_output(int unit_type, const UnitOutput
   return {true, true, poly};
 }
 
-std::vector<std::vector<int> > propagation::compute_output_mapping_from_connections(const connections_t &conn) {
-  vector<vector<int>> outgoing_conns(CONN_UNIT_COUNT);
+template<typename G>
+struct OutputMappingKernel {
+  static vector<vector<int>> run(G const & geometry, connections_t const & conn) {
+    return compute_output_mapping(geometry, conn);
+  }
+};
+
+std::vector<std::vector<int> > propagation::compute_output_mapping_from_connections(const connections_t &conn, const Geometry &geometry) {
+  return dispatch_geometry<OutputMappingKernel>(geometry, conn);
+}
+
+template<typename G>
+struct PropagationOrderKernel {
+  static vector<int> run(G const & geometry, connections_t const & conns) {
+    /* Do a forward traversal starting from the array input and propagate its
+     * signal to all connections. Then do the same for all units that have both
+     * inputs connected.
+     */
+
+    // first construct a reverse mapping from unit_id to list of units it is connected to
+    vector<vector<int>> outgoing_conns =
+      compute_output_mapping(geometry, conns);
+
+    // units whose output is known and units already scheduled
+    vector<bool> has_output(geometry.conn_unit_count(), false);
+    vector<bool> scheduled(geometry.conn_unit_count(), false);
+
+    vector<int> order;
+    order.push_back(geometry.array_input_id());
+    scheduled[geometry.array_input_id()] = true;
+
+    for(int pos = 0; pos < order.size(); ++ pos) {
+      int unit_id = order[pos];
+      has_output[unit_id] = true;
+
+      // propagate to its downstream units
+      for(int downstream_unit_id : outgoing_conns[unit_id]) {
+        // check if both inputs are connected and add it to the list to be processed
+        int down_unit_in_id1 = conns[downstream_unit_id * 2];
+        int down_unit_in_id2 = conns[downstream_unit_id * 2 + 1];
+
+        // sanity check
+        if(down_unit_in_id1 != unit_id && down_unit_in_id2 != unit_id) {
+          cerr << "ERROR: propagation graph structure is broken for unit " << unit_id << endl;
+        }
+
+        if(down_unit_in_id1 != -1 && down_unit_in_id2 != -1 && ! scheduled[downstream_unit_id]) {
+          // both inputs connected
+          // make sure both inputs have signal flowing through
+          if(has_output[down_unit_in_id1] && has_output[down_unit_in_id2]) {
+            order.push_back(downstream_unit_id);
+            scheduled[downstream_unit_id] = true;
+          }
+        }
+      }
+    }
+
+    return order;
+  }
+};
+
+std::vector<int> propagation::compute_propagation_order(const connections_t &conns, const Geometry &geometry) {
+  return dispatch_geometry<PropagationOrderKernel>(geometry, conns);
+}
+
+// the connections can be a plain vector or the copy-on-write array of a walker
+template<typename C>
+static vector<pair<int, int>> wired_edges(C const & conns, vector<int> const & wired_units) {
+  vector<pair<int, int>> edges;
+  edges.reserve(wired_units.size() * 2);
 
-  for(int uw_id = 0; uw_id < conn.size(); ++ uw_id) {
-    int in_unit_id = conn[uw_id];
-    if(in_unit_id != -1) {
-      int unit_id = uw_id / 2;
-      outgoing_conns[in_unit_id].push_back(unit_id);
+  for(int unit_id : wired_units) {
+    for(int input_id = unit_id * 2; input_id < unit_id * 2 + 2; ++ input_id) {
+      if(conns[input_id] != -1) {
+        edges.push_back({conns[input_id], unit_id});
+      }
     }
   }
+  sort(edges.begin(), edges.end());
 
-  return outgoing_conns;
+  return edges;
 }
 
-bool propagation::has_upstream_conn(const connections_t &conns, int downstream_unit_id, int upstream_unit_id) {
+template<typename C>
+static vector<int> wired_propagation_order(C const & conns, vector<int> const & wired_units, Geometry const & geometry) {
+  int array_input_id = geometry.array_input_id();
+
+  // the outgoing connections of each unit are a contiguous range of the edges
+  vector<pair<int, int>> edges = wired_edges(conns, wired_units);
+
+  /* Only wired units and the input of the array can have a signal, so they get
+   * local slots found by binary search. The input of the array has the highest
+   * id, so it goes last.
+   */
+  vector<int> slot_units(wired_units);
+  sort(slot_units.begin(), slot_units.end());
+  slot_units.push_back(array_input_id);
+
+  auto slot_of = [&slot_units](int unit_id) {
+    auto it = lower_bound(slot_units.begin(), slot_units.end(), unit_id);
+    return (it != slot_units.end() && *it == unit_id) ? (int) (it - slot_units.begin()) : -1;
+  };
+
+  // units whose output is known and units already scheduled
+  vector<bool> has_output(slot_units.size(), false);
+  vector<bool> scheduled(slot_units.size(), false);
+
+  auto slot_has_output = [&](int unit_id) {
+    int slot = slot_of(unit_id);
+    return slot != -1 && has_output[slot];
+  };
+
+  vector<int> order;
+  order.push_back(array_input_id);
+  scheduled[slot_units.size() - 1] = true;
+
+  for(int pos = 0; pos < order.size(); ++ pos) {
+    int unit_id = order[pos];
+    has_output[slot_of(unit_id)] = true;
+
+    // propagate to its downstream units
+    auto first = lower_bound(edges.begin(), edges.end(), make_pair(unit_id, numeric_limits<int>::lowest()));
+    for(auto it = first; it != edges.end() && it->first == unit_id; ++ it) {
+      int downstream_unit_id = it->second;
+      int down_unit_in_id1 = conns[downstream_unit_id * 2];
+      int down_unit_in_id2 = conns[downstream_unit_id * 2 + 1];
+      int down_slot = slot_of(downstream_unit_id);
+
+      if(down_unit_in_id1 != -1 && down_unit_in_id2 != -1 && ! scheduled[down_slot]) {
+        // both inputs connected, make sure both have signal flowing through
+        if(slot_has_output(down_unit_in_id1) && slot_has_output(down_unit_in_id2)) {
+          order.push_back(downstream_unit_id);
+          scheduled[down_slot] = true;
+        }
+      }
+    }
+  }
+
+  return order;
+}
+
+std::vector<std::pair<int, int> > propagation::compute_wired_edges(const connections_t &conns, const std::vector<int> &wired_units) {
+  return wired_edges(conns, wired_units);
+}
+
+std::vector<std::pair<int, int> > propagation::compute_wired_edges(const utils::cow_array<int> &conns, const std::vector<int> &wired_units) {
+  return wired_edges(conns, wired_units);
+}
+
+std::vector<int> propagation::compute_propagation_order(const connections_t &conns, const std::vector<int> &wired_units,
+                                                        const Geometry &geometry) {
+  return wired_propagation_order(conns, wired_units, geometry);
+}
+
+std::vector<int> propagation::compute_propagation_order(const utils::cow_array<int> &conns, const std::vector<int> &wired_units,
+                                                        const Geometry &geometry) {
+  return wired_propagation_order(conns, wired_units, geometry);
+}
+
+template<typename G>
+struct UnitOutputsKernel {
+  template<typename C>
+  static unit_outputs_t run(G const & geometry, C const & conns, vector<int> const & order,
+                            PropagationLimits const & limits, PropagationStats * const & stats) {
+    unit_outputs_t unit_outputs(geometry.conn_unit_count(), {false, false, {}});
+
+    // the input of the array always outputs the polynomial "x"
+    int array_input_id = geometry.array_input_id();
+    unit_outputs[array_input_id].has_output = true;
+    unit_outputs[array_input_id].is_valid = true;
+    unit_outputs[array_input_id].poly = {1};
+
+    // compute the outputs of the units with a signal, upstream units first
+    for(int unit_id : order) {
+      if(unit_id != array_input_id) {
+        int in_unit_id1 = conns[unit_id * 2];
+        int in_unit_id2 = conns[unit_id * 2 + 1];
+        unit_outputs[unit_id] = compute_one_unit_output(
+          geometry.unit_type(unit_id),
+          unit_outputs[in_unit_id1],
+          unit_outputs[in_unit_id2],
+          limits,
+          stats
+        );
+      }
+    }
+
+    return unit_outputs;
+  }
+};
+
+unit_outputs_t propagation::compute_unit_outputs(const connections_t &conns, const std::vector<int> &order, const Geometry &geometry,
+                                                 const PropagationLimits &limits, PropagationStats *stats) {
+  return dispatch_geometry<UnitOutputsKernel>(geometry, conns, order, limits, stats);
+}
+
+unit_outputs_t propagation::compute_unit_outputs(const utils::cow_array<int> &conns, const std::vector<int> &order, const Geometry &geometry,
+                                                 const PropagationLimits &limits, PropagationStats *stats) {
+  return dispatch_geometry<UnitOutputsKernel>(geometry, conns, order, limits, stats);
+}
+
+bool propagation::has_upstream_conn(const connections_t &conns, int downstream_unit_id, int upstream_unit_id,
+                                    const Geometry &geometry) {
+  int array_input_id = geometry.array_input_id();
+
   // handle special case; the array input unit has no upstream units
-  if(downstream_unit_id == ARRAY_INPUT_ID) {
+  if(downstream_unit_id == array_input_id) {
     return false;
   }
 
@@ -116,7 +398,7 @@ bool propagation::has_upstream_conn(const connections_t &conns, int downstream_u
       if(upstream_unit_id1 == upstream_unit_id) {
         return true;
       }
-      if(upstream_unit_id1 != ARRAY_INPUT_ID && added.count(upstream_unit_id1) == 0) {
+      if(upstream_unit_id1 != array_input_id && added.count(upstream_unit_id1) == 0) {
         queue.push_back(upstream_unit_id1);
         added.insert(upstream_unit_id1);
       }
@@ -127,7 +409,7 @@ bool propagation::has_upstream_conn(const connections_t &conns, int downstream_u
       if(upstream_unit_id2 == upstream_unit_id) {
         return true;
       }
-      if(upstream_unit_id2 != ARRAY_INPUT_ID && added.count(upstream_unit_id2) == 0) {
+      if(upstream_unit_id2 != array_input_id && added.count(upstream_unit_id2) == 0) {
         queue.push_back(upstream_unit_id2);
         added.insert(upstream_unit_id2);
       }
@@ -3,25 +3,115 @@
 
 #include <vector>
 #include "definitions.h"
+#include "utils/cow_array.h"
 
 namespace propagation {
+/* Upper bounds on the polynomials a unit is allowed to output.
+ * Multiplier chains make the number of terms grow as n * m and the powers
+ * grow without bound, so a few deep paths could dominate the runtime of a
+ * cycle (and eventually overflow int). Units whose output would exceed these
+ * limits are marked invalid before the output is materialized.
+ */
+struct PropagationLimits {
+  int max_degree;
+  int max_terms;
+};
+
+const PropagationLimits DEFAULT_LIMITS = {1024, 128};
+
+/* Telemetry: how many unit outputs were invalidated by each of the limits */
+struct PropagationStats {
+  long degree_limit_hits;
+  long term_limit_hits;
+};
+
 /* Sort a polynomial's powers in canonycal order */
 void sort_canonical(std::vector<int> * p);
 
+/* Order-preserving kernels for the sum and the product of two polynomials in
+ * canonical order. The result is in canonical order as well.
+ * They return false as soon as two terms share a power i.e. the result would
+ * be of the form "2*x", which is invalid.
+ */
+bool add_canonical(poly_t const & p1, poly_t const & p2, poly_t * sum);
+bool multiply_canonical(poly_t const & p1, poly_t const & p2, poly_t * product);
+
 /* Computes the output of a unit given its inputs that can be polynomials or invalid.
  * unit_type can be 0 (adder), 1 (multiplier) or 2 (divider)
+ * Inputs are expected to be in canonical order, which the output preserves.
+ *
+ * The output is invalid if it would exceed the given limits; when stats is
+ * not null the limit that fired is counted there.
  */
-UnitOutput compute_one_unit_output(int unit_type, UnitOutput const & in1, UnitOutput const & in2);
+UnitOutput compute_one_unit_output(int unit_type, UnitOutput const & in1, UnitOutput const & in2,
+                                   PropagationLimits const & limits = DEFAULT_LIMITS,
+                                   PropagationStats * stats = nullptr);
 
 /* Compute a mapping from unit output to the units it connects to
+ * This is the kernel for any geometry, see dispatch_geometry.
  */
-std::vector<std::vector<int>> compute_output_mapping_from_connections(connections_t const & conn);
+template<typename G>
+std::vector<std::vector<int>> compute_output_mapping(G const & geometry, connections_t const & conn) {
+  std::vector<std::vector<int>> outgoing_conns(geometry.conn_unit_count());
+
+  for(int uw_id = 0; uw_id < conn.size(); ++ uw_id) {
+    int in_unit_id = conn[uw_id];
+    if(in_unit_id != -1) {
+      int unit_id = uw_id / 2;
+      outgoing_conns[in_unit_id].push_back(unit_id);
+    }
+  }
+
+  return outgoing_conns;
+}
+
+/* Compute a mapping from unit output to the units it connects to
+ */
+std::vector<std::vector<int>> compute_output_mapping_from_connections(connections_t const & conn,
+                                                                     Geometry const & geometry = default_geometry());
+
+/* Ids of the units that get a signal flowing through them, starting with the
+ * input of the array and ordered such that every unit comes after both of
+ * its inputs. Units that are part of a cycle never get a signal.
+ */
+std::vector<int> compute_propagation_order(connections_t const & conns,
+                                           Geometry const & geometry = default_geometry());
+
+/* Connections of the given wired units as (upstream unit, downstream unit)
+ * pairs, sorted. Only the inputs of the wired units are looked at.
+ */
+std::vector<std::pair<int, int>> compute_wired_edges(connections_t const & conns, std::vector<int> const & wired_units);
+std::vector<std::pair<int, int>> compute_wired_edges(utils::cow_array<int> const & conns, std::vector<int> const & wired_units);
+
+/* Same order as above, computed only from the units that have at least one
+ * input connected. This takes O(w log w) for w wired units, independently of
+ * the size of the array.
+ */
+std::vector<int> compute_propagation_order(connections_t const & conns, std::vector<int> const & wired_units,
+                                           Geometry const & geometry = default_geometry());
+std::vector<int> compute_propagation_order(utils::cow_array<int> const & conns, std::vector<int> const & wired_units,
+                                           Geometry const & geometry = default_geometry());
+
+/* Compute what outputs each unit generates, following the propagation order.
+ * Units that are not in the order do not have an output.
+ */
+unit_outputs_t compute_unit_outputs(connections_t const & conns, std::vector<int> const & order,
+                                    Geometry const & geometry = default_geometry(),
+                                    PropagationLimits const & limits = DEFAULT_LIMITS,
+                                    PropagationStats * stats = nullptr);
+
+// same as above, reading the connections of a walker in place
+unit_outputs_t compute_unit_outputs(utils::cow_array<int> const & conns, std::vector<int> const & order,
+                                    Geometry const & geometry,
+                                    PropagationLimits const & limits = DEFAULT_LIMITS,
+                                    PropagationStats * stats = nullptr);
 
 /* Traverse the connection graph upstream and return true if there is
  * a connection from the unit with input input_id to unit_id i.e.
  * adding unit_id as a downstream connection from input_id would create a cycle.
  */
-bool has_upstream_conn(const connections_t &conns, int downstream_unit_id, int upstream_unit_id);
+bool has_upstream_conn(const connections_t &conns, int downstream_unit_id, int upstream_unit_id,
+                       Geometry const & geometry = default_geometry());
 
 }
 
@@ -0,0 +1,142 @@
+#include "recipes.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace propagation;
+
+bool recipes::make_power_recipe(const Geometry &geometry, int power, Recipe *recipe) {
+  auto multiplier = find(geometry.coll_types.begin(), geometry.coll_types.end(), 1);
+  if(power < 2 || multiplier == geometry.coll_types.end() || power - 1 > (int) geometry.rows) {
+    return false;
+  }
+  int coll = multiplier - geometry.coll_types.begin();
+  int coll_count = geometry.coll_count();
+
+  recipe->output = {power};
+  recipe->coll_types = geometry.coll_types;
+  recipe->row_count = power - 1;
+  recipe->wires.clear();
+
+  // x * x on the first row, then the unit above times x on each next one
+  for(int row = 0; row < power - 1; ++ row) {
+    int unit_id = row * coll_count + coll;
+    int upstream_id = row == 0 ? RECIPE_ARRAY_INPUT : unit_id - coll_count;
+    recipe->wires.push_back({unit_id * 2, upstream_id});
+    recipe->wires.push_back({unit_id * 2 + 1, RECIPE_ARRAY_INPUT});
+  }
+  return true;
+}
+
+bool recipes::extract_recipe(Walker *walker, const poly_t &output, const PropagationLimits &limits,
+                             Recipe *recipe) {
+  Geometry const & geometry = walker->geometry();
+  int coll_count = geometry.coll_count();
+  int array_input_id = geometry.array_input_id();
+
+  poly_t canonical = output;
+  sort_canonical(& canonical);
+
+  auto & outputs = walker->unit_outputs(limits);
+  int output_unit = -1;
+  for(int unit_id = 0; unit_id < array_input_id && output_unit == -1; ++ unit_id) {
+    if(outputs[unit_id].has_output && outputs[unit_id].is_valid && outputs[unit_id].poly == canonical) {
+      output_unit = unit_id;
+    }
+  }
+  if(output_unit == -1) {
+    return false;
+  }
+
+  // walk up from the unit producing the output
+  vector<bool> in_cone(array_input_id, false);
+  vector<int> pending {output_unit};
+  vector<pair<int, int>> wires;
+  int first_row = output_unit / coll_count;
+  int last_row = first_row;
+  in_cone[output_unit] = true;
+
+  while(! pending.empty()) {
+    int unit_id = pending.back();
+    pending.pop_back();
+    first_row = min(first_row, unit_id / coll_count);
+    last_row = max(last_row, unit_id / coll_count);
+
+    for(int input_id = unit_id * 2; input_id < unit_id * 2 + 2; ++ input_id) {
+      int upstream_id = walker->input(input_id);
+      if(upstream_id == -1) {
+        continue;
+      }
+      wires.push_back({input_id, upstream_id});
+      if(upstream_id != array_input_id && ! in_cone[upstream_id]) {
+        in_cone[upstream_id] = true;
+        pending.push_back(upstream_id);
+      }
+    }
+  }
+
+  int unit_shift = first_row * coll_count;
+  for(auto & wire : wires) {
+    wire.first -= unit_shift * 2;
+    wire.second = wire.second == array_input_id ? RECIPE_ARRAY_INPUT : wire.second - unit_shift;
+  }
+  sort(wires.begin(), wires.end());
+
+  recipe->output = canonical;
+  recipe->coll_types = geometry.coll_types;
+  recipe->row_count = last_row - first_row + 1;
+  recipe->wires = std::move(wires);
+  return true;
+}
+
+bool recipes::place_recipe(const Recipe &recipe, int row_offset, Walker *walker) {
+  Geometry const & geometry = walker->geometry();
+  if(recipe.coll_types != geometry.coll_types || row_offset < 0 ||
+     row_offset + recipe.row_count > (int) geometry.rows) {
+    return false;
+  }
+
+  // the recipe only wires inputs of its own units, which must be free
+  int unit_shift = row_offset * geometry.coll_count();
+  for(auto & wire : recipe.wires) {
+    int unit_id = wire.first / 2 + unit_shift;
+    if(walker->input(unit_id * 2) != -1 || walker->input(unit_id * 2 + 1) != -1) {
+      return false;
+    }
+  }
+
+  for(auto & wire : recipe.wires) {
+    int upstream_id = wire.second == RECIPE_ARRAY_INPUT ? geometry.array_input_id() : wire.second + unit_shift;
+    walker->rewire(wire.first + unit_shift * 2, upstream_id);
+  }
+  return true;
+}
+
+void recipes::make_recipe_library(const poly_t &target, const Geometry &geometry,
+                                  const SolutionDatabase *database, const PropagationLimits &limits,
+                                  std::vector<Recipe> *library) {
+  library->clear();
+
+  for(int power : target) {
+    Recipe best;
+    bool found = make_power_recipe(geometry, power, & best);
+
+    vector<BestCircuit> circuits;
+    if(power >= 2 && database != nullptr && database->find({power}, geometry, & circuits)) {
+      for(auto & circuit : circuits) {
+        Walker walker(geometry, circuit.conns);
+
+        Recipe recipe;
+        if(extract_recipe(& walker, {power}, limits, & recipe) &&
+           (! found || recipe.row_count < best.row_count)) {
+          best = std::move(recipe);
+          found = true;
+        }
+      }
+    }
+
+    if(found) {
+      library->push_back(std::move(best));
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef RECIPES_H
+#define RECIPES_H
+
+#include <vector>
+#include "definitions.h"
+#include "propagation.h"
+#include "walker.h"
+#include "solution_database.h"
+
+namespace recipes {
+
+// stands for the input of the array in the wires of a recipe
+const int RECIPE_ARRAY_INPUT = -2;
+
+/* A circuit producing a given polynomial, cut out of the array so that it
+ * can be placed at any row: unit and input ids count from the first row it
+ * spans. Since unit types only depend on the column, a recipe works the same
+ * at every row of an array with the same columns.
+ */
+struct Recipe {
+  poly_t output;
+  std::vector<int> coll_types;
+  int row_count;
+
+  // (input id, unit id) of each connected input
+  std::vector<std::pair<int, int>> wires;
+};
+
+/* Built-in recipe for x^power: a chain of multipliers down one column, each
+ * multiplying the previous one by x. False if the array has no multiplier
+ * column or too few rows, or if power is below 2.
+ */
+bool make_power_recipe(Geometry const & geometry, int power, Recipe * recipe);
+
+/* Recipe for the first unit of the walker whose output is the given
+ * polynomial, made of that unit and everything upstream of it. False if no
+ * unit produces it.
+ */
+bool extract_recipe(Walker * walker, poly_t const & output, propagation::PropagationLimits const & limits,
+                    Recipe * recipe);
+
+/* Wire the recipe into the walker starting at row_offset. False, leaving
+ * the walker as it was, if the recipe does not fit there or any of the units
+ * it uses already has an input connected.
+ */
+bool place_recipe(Recipe const & recipe, int row_offset, Walker * walker);
+
+/* The smallest recipe known for each term of the target above x: out of
+ * the circuits recovering that term alone in the database, when given one,
+ * and the built-in one.
+ */
+void make_recipe_library(poly_t const & target, Geometry const & geometry,
+                         SolutionDatabase const * database, propagation::PropagationLimits const & limits,
+                         std::vector<Recipe> * library);
+
+}
+
+#endif // RECIPES_H
@@ -0,0 +1,157 @@
+#include "replica_exchange.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+using namespace scoring;
+
+// keeps temperatures positive when a replica runs without noise
+static const double MIN_TEMPERATURE = 1e-9;
+
+ReplicaExchange::ReplicaExchange(const vector<int> &polynomial, const vector<double> &noise_levels,
+                                 int walkers_per_replica, ScoringParams params, const Geometry &geometry)
+  : noise_levels(noise_levels),
+    exchange{5, 2, 10.0},
+    random_generator(random_device{}()) {
+  sort(this->noise_levels.begin(), this->noise_levels.end());
+
+  for(int level = 0; level < this->noise_levels.size(); ++ level) {
+    replicas.emplace_back(new StochasticSearch(polynomial, walkers_per_replica, params, geometry));
+    replicas.back()->set_verbose(false);
+
+    if(level == 0) {
+      best_tracker = replicas[0]->best_circuits();
+    } else {
+      replicas.back()->set_best_tracker(best_tracker);
+    }
+  }
+}
+
+void ReplicaExchange::set_seed(unsigned seed) {
+  seed_seq seeds{seed};
+  vector<unsigned> replica_seeds(replicas.size() + 1);
+  seeds.generate(replica_seeds.begin(), replica_seeds.end());
+
+  for(int level = 0; level < replicas.size(); ++ level) {
+    replicas[level]->set_seed(replica_seeds[level]);
+  }
+  random_generator.seed(replica_seeds.back());
+}
+
+void ReplicaExchange::set_exchange(const ExchangeParams &params) {
+  exchange = params;
+  exchange.interval = max(1, exchange.interval);
+}
+
+ScoreOutput ReplicaExchange::train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise) {
+  replica_best.assign(replicas.size(), {0, numeric_limits<double>::lowest()});
+  attempted_swaps.assign(max<int>(0, replicas.size() - 1), 0);
+  accepted_swaps.assign(attempted_swaps.size(), 0);
+
+  int round_id = 0;
+  for(int first_iteration = 0; first_iteration < iteration_count; first_iteration += exchange.interval) {
+    int last_iteration = min(first_iteration + exchange.interval, iteration_count);
+
+    vector<thread> threads;
+    for(int level = 0; level < replicas.size(); ++ level) {
+      threads.emplace_back(&ReplicaExchange::train_replica, this, level, first_iteration, last_iteration,
+                           iteration_count, cycle_count, clone_count, noise);
+    }
+    for(auto & replica_thread : threads) {
+      replica_thread.join();
+    }
+
+    // even pairs of levels on even rounds, odd pairs on odd ones
+    if(last_iteration < iteration_count) {
+      for(int level = round_id % 2; level + 1 < replicas.size(); level += 2) {
+        exchange_walkers(level);
+      }
+    }
+    ++ round_id;
+  }
+
+  ScoreOutput best = {0, numeric_limits<double>::lowest()};
+  for(int level = 0; level < replicas.size(); ++ level) {
+    cout << "Replica " << level
+         << "\tnoise: " << setprecision(2) << noise_levels[level]
+         << "\tbest score: " << setprecision(2) << replica_best[level].best_score
+         << "\tfunction was recovered " << replica_best[level].times_function_recovered
+         << " times" << endl;
+
+    if(best.best_score < replica_best[level].best_score) {
+      best = replica_best[level];
+    }
+  }
+
+  auto rates = acceptance_rates();
+  for(int level = 0; level < rates.size(); ++ level) {
+    cout << "Swaps " << level << " <-> " << level + 1
+         << "\taccepted " << accepted_swaps[level] << " / " << attempted_swaps[level]
+         << " (" << setprecision(2) << rates[level] << ")" << endl;
+  }
+
+  return best;
+}
+
+void ReplicaExchange::train_replica(int level, int first_iteration, int last_iteration, int iteration_count,
+                                    int cycle_count, int clone_count, const NoiseParams &noise) {
+  // the same fraction of inputs changed at every iteration
+  NoiseParams level_noise = noise;
+  level_noise.starting_inputs_change_fraction = noise_levels[level];
+  level_noise.min_inputs_change_fraction = noise_levels[level];
+  level_noise.inputs_change_decay = 0;
+
+  StochasticSearch & search = *replicas[level];
+  for(int iter_id = first_iteration; iter_id < last_iteration; ++ iter_id) {
+    auto score_out = search.train_iteration(iter_id, iteration_count, cycle_count, clone_count, level_noise);
+    if(replica_best[level].best_score < score_out.best_score) {
+      replica_best[level] = score_out;
+    }
+  }
+}
+
+void ReplicaExchange::exchange_walkers(int level) {
+  StochasticSearch & cold = *replicas[level];
+  StochasticSearch & hot = *replicas[level + 1];
+
+  vector<int> cold_ids;
+  vector<int> hot_ids;
+  vector<double> cold_scores;
+  vector<double> hot_scores;
+  cold.get_best_walker_ids(exchange.walker_count, & cold_ids, & cold_scores);
+  hot.get_best_walker_ids(exchange.walker_count, & hot_ids, & hot_scores);
+
+  double cold_beta = 1.0 / max(noise_levels[level] * exchange.temperature_scale, MIN_TEMPERATURE);
+  double hot_beta = 1.0 / max(noise_levels[level + 1] * exchange.temperature_scale, MIN_TEMPERATURE);
+  uniform_real_distribution<double> dist_acceptance(0.0, 1.0);
+
+  for(int pos = 0; pos < cold_ids.size() && pos < hot_ids.size(); ++ pos) {
+    ++ attempted_swaps[level];
+
+    // Metropolis: a better walker moving down to the colder replica is always accepted
+    double log_acceptance = (hot_scores[pos] - cold_scores[pos]) * (cold_beta - hot_beta);
+    if(log_acceptance < 0 && dist_acceptance(random_generator) >= exp(log_acceptance)) {
+      continue;
+    }
+
+    Walker cold_walker = cold.walker(cold_ids[pos]);
+    cold.replace_walker(cold_ids[pos], hot.walker(hot_ids[pos]));
+    hot.replace_walker(hot_ids[pos], cold_walker);
+    ++ accepted_swaps[level];
+  }
+}
+
+std::vector<double> ReplicaExchange::acceptance_rates() const {
+  vector<double> rates(attempted_swaps.size(), 0.0);
+  for(int level = 0; level < rates.size(); ++ level) {
+    if(attempted_swaps[level] > 0) {
+      rates[level] = (double) accepted_swaps[level] / attempted_swaps[level];
+    }
+  }
+  return rates;
+}
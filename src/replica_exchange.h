@@ -0,0 +1,100 @@
+#ifndef REPLICAEXCHANGE_H
+#define REPLICAEXCHANGE_H
+
+#include "definitions.h"
+#include "scoring.h"
+#include "stochastic_search.h"
+#include "walker.h"
+#include "best_tracker.h"
+#include <memory>
+#include <random>
+#include <vector>
+
+struct ExchangeParams {
+  // iterations between two rounds of exchanges
+  int interval;
+
+  // number of walkers, best first, each pair of replicas tries to swap
+  int walker_count;
+
+  // temperature of a replica per unit of noise level, in units of score
+  double temperature_scale;
+};
+
+/* Replica exchange, or parallel tempering, on top of the stochastic search.
+ *
+ * Each replica is a StochasticSearch whose noise stays at a fixed level
+ * instead of decaying, trained on its own thread. Low levels refine the
+ * circuits they have, high levels keep exploring. After every few
+ * iterations replicas at adjacent levels try to swap their best walkers,
+ * the k-th best of one against the k-th best of the other, with the
+ * Metropolis criterion on their scores: a swap that moves the better walker
+ * to the lower level always happens, the opposite one with probability
+ *
+ *   exp(-(score_low - score_high) * (1 / T_low - 1 / T_high))
+ *
+ * where the temperature T of a replica is its noise level times
+ * temperature_scale. Even and odd pairs of levels take turns, and swaps
+ * happen between rounds of training, so runs are reproducible for a seed
+ * whatever the scheduling of the threads.
+ *
+ * Good circuits thus flow down to the low levels without a decay schedule
+ * to tune for each target.
+ */
+class ReplicaExchange {
+  std::vector<std::unique_ptr<StochasticSearch>> replicas;
+
+  // fraction of inputs changed by the noise of each replica, increasing
+  std::vector<double> noise_levels;
+
+  ExchangeParams exchange;
+  std::mt19937 random_generator;
+
+  // best score of each replica over the last call to train
+  std::vector<ScoreOutput> replica_best;
+
+  // swaps tried and done between each level and the next one
+  std::vector<long> attempted_swaps;
+  std::vector<long> accepted_swaps;
+
+  // shared by all replicas
+  std::shared_ptr<BestTracker> best_tracker;
+
+  // iterations [first_iteration, last_iteration) of the replica at level
+  void train_replica(int level, int first_iteration, int last_iteration, int iteration_count,
+                     int cycle_count, int clone_count, NoiseParams const & noise);
+
+  // try to swap the best walkers of the replicas at level and level + 1
+  void exchange_walkers(int level);
+
+public:
+  ReplicaExchange(std::vector<int> const & polynomial, std::vector<double> const & noise_levels,
+                  int walkers_per_replica, scoring::ScoringParams params,
+                  Geometry const & geometry = default_geometry());
+
+  int replica_count() const { return replicas.size(); }
+
+  // access to a replica e.g. to configure it before training
+  StochasticSearch & replica(int level) { return *replicas[level]; }
+
+  // seeds each replica and the swaps from the given seed, for reproducible runs
+  void set_seed(unsigned seed);
+
+  void set_exchange(ExchangeParams const & params);
+
+  /* Train all replicas in parallel and return the best score over all of
+   * them. The noise parameters other than the fraction of inputs changed
+   * apply to all replicas.
+   */
+  ScoreOutput train(int iteration_count, int cycle_count, int clone_count, NoiseParams const & noise);
+
+  std::vector<ScoreOutput> const & best_per_replica() const { return replica_best; }
+
+  // fraction of the swaps tried between each level and the next one that happened
+  std::vector<double> acceptance_rates() const;
+
+  // the best circuits over all replicas, see BestTracker
+  std::shared_ptr<BestTracker> best_circuits() const { return best_tracker; }
+};
+
+#endif // REPLICAEXCHANGE_H
@@ -1,5 +1,6 @@
 #include "scoring.h"
 #include "propagation.h"
+#include "walker.h"
 #include "utils/disjoint_sets.h"
 
 #include <cmath>
@@ -33,115 +34,371 @@ double scoring::compute_poly_distance(const std::vector<int> &target, const std:
   }
 
   // TODO: there's a hidden hyperparameter here
-  distance += abs(target.size() - candidate.size());
+  distance += abs((int) target.size() - (int) candidate.size());
 
   return distance;
 }
 
-int scoring::compute_wire_lengths(const connections_t &conns) {
-  int lens = 0;
+scoring::ScoringPlan scoring::make_scoring_plan(const poly_t &target, int max_degree) {
+  ScoringPlan plan;
+  plan.target = target;
+  sort_canonical(& plan.target);
 
-  // we need to compute the lengths for each individual wire i.e. unit output
-  vector<vector<int>> outgoing_conns =
-      compute_output_mapping_from_connections(conns);
+  // the tables have to cover all target powers and all powers a valid candidate can have
+  int min_power = 0;
+  int max_power = max_degree;
+  if(! plan.target.empty()) {
+    min_power = min(min_power, plan.target.back());
+    max_power = max(max_power, plan.target.front());
+  }
 
-  // we need to consider each wire individually
-  for(int unit_id = 0; unit_id < UNIT_COUNT; ++ unit_id) {
-    auto & out_conns = outgoing_conns[unit_id];
-    if(! out_conns.empty()) {
-      // make a copy and store all points of the wire, including source
-      vector<int> wire(outgoing_conns[unit_id]);
-      wire.push_back(unit_id);
+  // index 0 stands for all powers below min_power
+  plan.min_power = min_power;
+  plan.max_power = max_power;
+  plan.term_count_upto.assign(max_power - min_power + 2, 0);
+  plan.power_sum_upto.assign(max_power - min_power + 2, 0);
 
-      lens += compute_one_wire_length(wire);
-    }
+  for(int p : plan.target) {
+    plan.term_count_upto[p - min_power + 1] += 1;
+    plan.power_sum_upto[p - min_power + 1] += p;
+  }
+  for(int pid = 1; pid < plan.term_count_upto.size(); ++ pid) {
+    plan.term_count_upto[pid] += plan.term_count_upto[pid - 1];
+    plan.power_sum_upto[pid] += plan.power_sum_upto[pid - 1];
+  }
+
+  // past a few dozen the values are too small to matter, but we still compute them exactly
+  const int exp_table_size = 64;
+  plan.exp_neg_distance.resize(exp_table_size);
+  for(int d = 0; d < exp_table_size; ++ d) {
+    plan.exp_neg_distance[d] = exp(-1.0 * d);
   }
 
-  return lens;
+  return plan;
+}
+
+// position of power p in the prefix tables of the plan
+static inline long long plan_index(const scoring::ScoringPlan &plan, long long p) {
+  long long pid = p - plan.min_power + 1;
+  return max(0LL, min(pid, (long long) plan.term_count_upto.size() - 1));
+}
+
+/* Cost of the target terms strictly between two consecutive candidate terms,
+ * each of them goes to the closest end of the gap.
+ */
+static inline long long gap_cost(const scoring::ScoringPlan &plan, long long hi, long long lo) {
+  long long mid = lo + (hi - lo) / 2;
+
+  long long lo_id = plan_index(plan, lo);
+  long long mid_id = plan_index(plan, mid);
+  long long hi_id = plan_index(plan, hi - 1);
+
+  auto & count = plan.term_count_upto;
+  auto & sum = plan.power_sum_upto;
+
+  return (sum[mid_id] - sum[lo_id]) - lo * (count[mid_id] - count[lo_id])
+       + hi * (count[hi_id] - count[mid_id]) - (sum[hi_id] - sum[mid_id]);
+}
+
+/* Target terms above the highest candidate term (or below the lowest one) are
+ * handled as a gap to a sentinel far enough that all of them go to the
+ * candidate term.
+ */
+static inline long long high_sentinel(const scoring::ScoringPlan &plan, long long high) {
+  return high + 2 * max(0LL, plan.max_power - high) + 2;
 }
 
-int scoring::compute_one_wire_length(const vector<int> &wire) {
-  /* Note that currently we don't account for wire lengths from the input
-   * of the array to the first unit and from the last unit to the output.
-   *
-   * This should not change the results qualitatively, but should still be
-   * improved.
+static inline long long low_sentinel(const scoring::ScoringPlan &plan, long long low) {
+  return low - 2 * max(0LL, low - plan.min_power) - 2;
+}
+
+double scoring::compute_poly_distance(const ScoringPlan &plan, const poly_t &candidate) {
+  if(candidate.empty()) {
+    // infinite distance for nonexistent candidate
+    return numeric_limits<double>::max();
+  }
+
+  long long distance = gap_cost(plan, high_sentinel(plan, candidate.front()), candidate.front());
+  for(int cid = 0; cid + 1 < candidate.size(); ++ cid) {
+    distance += gap_cost(plan, candidate[cid], candidate[cid + 1]);
+  }
+  distance += gap_cost(plan, candidate.back(), low_sentinel(plan, candidate.back()));
+
+  // TODO: there's a hidden hyperparameter here
+  distance += abs((long long) plan.target.size() - (long long) candidate.size());
+
+  return distance;
+}
+
+scoring::DistanceSummary scoring::compute_top_distances(const ScoringPlan &plan, const unit_outputs_t &unit_outputs, int top_k) {
+  /* Pack the gaps of all valid candidates into flat arrays, including the
+   * sentinel gaps at both ends, so that all of them are costed by the same
+   * branch-free loop below.
    */
-  int row_low = numeric_limits<int>::max();
-  int row_high = numeric_limits<int>::lowest();
+  vector<long long> gap_high;
+  vector<long long> gap_low;
+  vector<int> candidate_gap_end;
+  vector<int> candidate_size;
+
+  gap_high.reserve(unit_outputs.size() * 4);
+  gap_low.reserve(unit_outputs.size() * 4);
 
-  // find longest vertical strip
-  for(int unit_id : wire) {
-    int unit_row = unit_id / UNIT_COLL_COUNT;
+  for(auto & uo : unit_outputs) {
+    if(! uo.has_output || ! uo.is_valid || uo.poly.empty()) {
+      continue;
+    }
+
+    auto & candidate = uo.poly;
+    gap_high.push_back(high_sentinel(plan, candidate.front()));
+    gap_low.push_back(candidate.front());
+    for(int cid = 0; cid + 1 < candidate.size(); ++ cid) {
+      gap_high.push_back(candidate[cid]);
+      gap_low.push_back(candidate[cid + 1]);
+    }
+    gap_high.push_back(candidate.back());
+    gap_low.push_back(low_sentinel(plan, candidate.back()));
 
-    row_low = min(row_low, unit_row);
-    row_high = max(row_high, unit_row);
+    candidate_gap_end.push_back(gap_high.size());
+    candidate_size.push_back(candidate.size());
   }
 
-  // store each unit in its distinct group that we unify as we go along
-  utils::disj_sets groups(wire.size());
+  vector<long long> costs(gap_high.size());
+  for(int gid = 0; gid < costs.size(); ++ gid) {
+    costs[gid] = gap_cost(plan, gap_high[gid], gap_low[gid]);
+  }
+
+  // reduce the gaps of each candidate and keep the top k distances in increasing order
+  DistanceSummary summary{{}, 0};
+  summary.top_distances.reserve(top_k + 1);
 
-  // unify all units within a distance of 1
-  for(int i = 0; i < wire.size() - 1; ++ i) {
-    int row1 = wire[i] / UNIT_COLL_COUNT;
-    int col1 = wire[i] % UNIT_COLL_COUNT;
-    for(int j = i + 1; j < wire.size(); ++ j) {
-      int row2 = wire[j] / UNIT_COLL_COUNT;
-      int col2 = wire[j] % UNIT_COLL_COUNT;
+  int gid = 0;
+  for(int cid = 0; cid < candidate_gap_end.size(); ++ cid) {
+    long long distance = abs((long long) plan.target.size() - candidate_size[cid]);
+    for(; gid < candidate_gap_end[cid]; ++ gid) {
+      distance += costs[gid];
+    }
 
-      if(abs(row1 - row2) + abs(col1 - col2) == 1) {
-        groups.merge(i, j);
+    // a distance of 0 means every target term is matched and there are no extra terms
+    if(distance == 0) {
+      ++ summary.times_recovered;
+    }
+
+    auto & top = summary.top_distances;
+    if(top.size() < top_k || distance < top.back()) {
+      top.insert(upper_bound(top.begin(), top.end(), (double) distance), distance);
+      if(top.size() > top_k) {
+        top.pop_back();
       }
     }
   }
 
-  // store overall wire length estimation
-  int len = 0;
+  return summary;
+}
 
-  // create a vertical wire as the backbone
-  len += row_high - row_low;
+double scoring::compute_exp_neg_distance(const ScoringPlan &plan, double distance) {
+  if(distance >= 0 && distance < plan.exp_neg_distance.size()) {
+    int d = (int) distance;
+    if(d == distance) {
+      return plan.exp_neg_distance[d];
+    }
+  }
+  return exp(-1.0 * distance);
+}
 
-  // assume a vertical line through each column and get the minimum spanning wire
-  int min_dist = numeric_limits<int>::max();
-  for(int coll_id = 0; coll_id < UNIT_COLL_COUNT; ++ coll_id) {
-    int coll_dist = 0;
+template<typename G>
+struct OneWireLengthKernel {
+  static int run(G const & geometry, vector<int> const & wire) {
+    /* Note that currently we don't account for wire lengths from the input
+     * of the array to the first unit and from the last unit to the output.
+     *
+     * This should not change the results qualitatively, but should still be
+     * improved.
+     */
+    int row_low = numeric_limits<int>::max();
+    int row_high = numeric_limits<int>::lowest();
 
-    // store minimum distance from a group of 1-connected units to the vertical wire
-    vector<int> group_distance(wire.size(), numeric_limits<int>::max());
+    // find longest vertical strip
+    for(int unit_id : wire) {
+      int unit_row = unit_id / geometry.coll_count();
 
-    for(int wid = 0; wid < wire.size(); ++ wid) {
-      int unit_id = wire[wid];
-      // compute distance from current unit to the vertical wire
-      int unit_coll = unit_id % UNIT_COLL_COUNT;
+      row_low = min(row_low, unit_row);
+      row_high = max(row_high, unit_row);
+    }
+
+    // store each unit in its distinct group that we unify as we go along
+    utils::disj_sets groups(wire.size());
+
+    // unify all units within a distance of 1
+    for(int i = 0; i < wire.size() - 1; ++ i) {
+      int row1 = wire[i] / geometry.coll_count();
+      int col1 = wire[i] % geometry.coll_count();
+      for(int j = i + 1; j < wire.size(); ++ j) {
+        int row2 = wire[j] / geometry.coll_count();
+        int col2 = wire[j] % geometry.coll_count();
 
-      int group_id = groups.get_representative(wid);
-      group_distance[group_id] = min(group_distance[group_id], abs(unit_coll - coll_id));
+        if(abs(row1 - row2) + abs(col1 - col2) == 1) {
+          groups.merge(i, j);
+        }
+      }
     }
 
-    // go through all groups and accumulate minimum distances
-    for(int wid = 0; wid < wire.size(); ++ wid) {
-      int group_id = groups.get_representative(wid);
-      if(group_distance[group_id] > 0) { // current unit group is not 1-coonected to the vertical wire
-        if(group_id == wid) {
-          /* This is the "leader" of the current group.
-           * It has no special meaning, but we can use it to avoid connecting
-           * the group twice to the vertical wire since the leader is unique
-           */
-          coll_dist += group_distance[group_id];
-        } else {
-          /* This is a unit that is 1-connected to the vertical wire.
-           * Now we add its connection
-           */
-          coll_dist += 1;
+    // store overall wire length estimation
+    int len = 0;
+
+    // create a vertical wire as the backbone
+    len += row_high - row_low;
+
+    // assume a vertical line through each column and get the minimum spanning wire
+    int min_dist = numeric_limits<int>::max();
+    for(int coll_id = 0; coll_id < geometry.coll_count(); ++ coll_id) {
+      int coll_dist = 0;
+
+      // store minimum distance from a group of 1-connected units to the vertical wire
+      vector<int> group_distance(wire.size(), numeric_limits<int>::max());
+
+      for(int wid = 0; wid < wire.size(); ++ wid) {
+        int unit_id = wire[wid];
+        // compute distance from current unit to the vertical wire
+        int unit_coll = unit_id % geometry.coll_count();
+
+        int group_id = groups.get_representative(wid);
+        group_distance[group_id] = min(group_distance[group_id], abs(unit_coll - coll_id));
+      }
+
+      // go through all groups and accumulate minimum distances
+      for(int wid = 0; wid < wire.size(); ++ wid) {
+        int group_id = groups.get_representative(wid);
+        if(group_distance[group_id] > 0) { // current unit group is not 1-coonected to the vertical wire
+          if(group_id == wid) {
+            /* This is the "leader" of the current group.
+             * It has no special meaning, but we can use it to avoid connecting
+             * the group twice to the vertical wire since the leader is unique
+             */
+            coll_dist += group_distance[group_id];
+          } else {
+            /* This is a unit that is 1-connected to the vertical wire.
+             * Now we add its connection
+             */
+            coll_dist += 1;
+          }
         }
       }
+
+      // update minimum spanning distance
+      min_dist = min(min_dist, coll_dist);
+    }
+
+    len += min_dist;
+
+    return len;
+  }
+};
+
+template<typename G>
+struct WireLengthsKernel {
+  static int run(G const & geometry, connections_t const & conns) {
+    int lens = 0;
+
+    // we need to compute the lengths for each individual wire i.e. unit output
+    vector<vector<int>> outgoing_conns =
+        compute_output_mapping(geometry, conns);
+
+    // we need to consider each wire individually
+    for(int unit_id = 0; unit_id < geometry.unit_count(); ++ unit_id) {
+      auto & out_conns = outgoing_conns[unit_id];
+      if(! out_conns.empty()) {
+        // make a copy and store all points of the wire, including source
+        vector<int> wire(outgoing_conns[unit_id]);
+        wire.push_back(unit_id);
+
+        lens += OneWireLengthKernel<G>::run(geometry, wire);
+      }
+    }
+
+    return lens;
+  }
+};
+
+template<typename G>
+struct WiredLengthsKernel {
+  static int run(G const & geometry, connections_t const & conns, vector<int> const & wired_units) {
+    int lens = 0;
+
+    // the edges are sorted, so the outgoing connections of each unit are contiguous
+    vector<pair<int, int>> edges = compute_wired_edges(conns, wired_units);
+
+    vector<int> wire;
+    for(int eid = 0; eid < edges.size(); ) {
+      int unit_id = edges[eid].first;
+
+      // store all points of the wire, including source
+      wire.clear();
+      for(; eid < edges.size() && edges[eid].first == unit_id; ++ eid) {
+        wire.push_back(edges[eid].second);
+      }
+      wire.push_back(unit_id);
+
+      // wires from the input of the array are not accounted for
+      if(unit_id < geometry.unit_count()) {
+        lens += OneWireLengthKernel<G>::run(geometry, wire);
+      }
     }
 
-    // update minimum spanning distance
-    min_dist = min(min_dist, coll_dist);
+    return lens;
+  }
+};
+
+int scoring::compute_wire_lengths(const connections_t &conns, const std::vector<int> &wired_units, const Geometry &geometry) {
+  return dispatch_geometry<WiredLengthsKernel>(geometry, conns, wired_units);
+}
+
+int scoring::compute_wire_lengths(const connections_t &conns, const Geometry &geometry) {
+  return dispatch_geometry<WireLengthsKernel>(geometry, conns);
+}
+
+int scoring::compute_one_wire_length(const vector<int> &wire, const Geometry &geometry) {
+  return dispatch_geometry<OneWireLengthKernel>(geometry, wire);
+}
+
+ScoreOutput scoring::score_walker(Walker *walker, const ScoringPlan &plan, const ScoringParams &params,
+                                  const PropagationLimits &limits,
+                                  PropagationStats *stats, int *wire_lengths) {
+  double score = 0;
+
+  // score having a wire connection from the input of the array
+  if(walker->is_array_input_connected()) {
+    score += params.input_recovered_factor;
+  }
+
+  // score number of units that have both inputs connected
+  int count_both_inputs_connected = walker->count_both_inputs_connected();
+  if(count_both_inputs_connected > 0) {
+    score += 1.0 + count_both_inputs_connected * params.unit_both_inputs_factor;
+  }
+
+  // score distance between unit outputs and function terms
+  auto & unit_outputs = walker->unit_outputs(limits, stats);
+
+  // take the top 3 closes distances and add them to the score
+  auto summary = compute_top_distances(plan, unit_outputs, 3);
+
+  for(double distance : summary.top_distances) {
+    // we actually want the opposite of the distance
+    // take exp(-distance) because we want this to be symetrically "spikey"
+    score += compute_exp_neg_distance(plan, distance) * params.distance_factor;
+  }
+
+  // score all terms that were successfully recovered (still useful in light of the above ?)
+
+  // extra score if the whole function is recovered by a unit output
+  int times_recovered = summary.times_recovered;
+  if(times_recovered > 0) {
+    score += params.function_recovered_factor;
   }
 
-  len += min_dist;
+  // score speed prior i.e. all wire lengths
+  *wire_lengths = walker->wire_lengths();
+  score += params.speed_prior_factor * 1.0 / (1.0 + *wire_lengths);
 
-  return len;
+  return {times_recovered, score};
 }
@@ -3,6 +3,14 @@
 
 #include <vector>
 #include "definitions.h"
+#include "propagation.h"
+
+class Walker;
+
+struct ScoreOutput {
+  int times_function_recovered;
+  double best_score;
+};
 
 namespace scoring {
 struct ScoringParams {
@@ -16,6 +24,59 @@ struct ScoringParams {
   double speed_prior_factor;
 };
 
+/* The target polynomial is fixed for the whole search, so everything the
+ * scoring needs to know about it is precomputed once.
+ *
+ * For a candidate sorted in canonical order every target term is closest to
+ * one of the two candidate terms around it, so the distance below is a sum
+ * over the gaps between consecutive candidate terms. The cost of a gap only
+ * depends on how many target terms fall on each side of its middle and on
+ * their sum, which we read from prefix tables indexed by power.
+ */
+struct ScoringPlan {
+  // the target polynomial in canonical order
+  poly_t target;
+
+  // prefix tables over powers in [min_power, max_power]: number of target
+  // terms with a power <= p and the sum of their powers
+  int min_power;
+  int max_power;
+  std::vector<int> term_count_upto;
+  std::vector<long long> power_sum_upto;
+
+  // exp(-d) for the integer distances we expect to see most often
+  std::vector<double> exp_neg_distance;
+};
+
+/* Build the scoring plan for a target. max_degree is the highest power a
+ * candidate is expected to have, it only bounds the size of the tables.
+ */
+ScoringPlan make_scoring_plan(poly_t const & target, int max_degree);
+
+/* Same as the distance below, computed from the plan of the target.
+ * The candidate must be in canonical order.
+ */
+double compute_poly_distance(ScoringPlan const & plan, poly_t const & candidate);
+
+/* Distances of the valid unit outputs closest to the target.
+ */
+struct DistanceSummary {
+  // at most top_k distances, in increasing order
+  std::vector<double> top_distances;
+
+  // number of unit outputs equal to the target
+  int times_recovered;
+};
+
+/* Batched version of the distance above over all valid unit outputs at once.
+ * The candidates are packed into flat arrays of gaps that are costed in a
+ * single loop, and the top k reduction happens while unpacking the result.
+ */
+DistanceSummary compute_top_distances(ScoringPlan const & plan, unit_outputs_t const & unit_outputs, int top_k);
+
+// exp(-distance), looked up in the plan for integer distances
+double compute_exp_neg_distance(ScoringPlan const & plan, double distance);
+
 /* Estimate a "distance" between a target polynomial and a candidate.
  * This distance is not symmetrical since our goal is to recover the target.
  * The distance is always positive or zero.
@@ -77,10 +138,24 @@ double compute_poly_distance(std::vector<int> const & target, std::vector<int> c
  * TODO: Account for wire length from the input of the array to the first
  * unit and from the last unit to the output of the array.
  */
-int compute_wire_lengths(connections_t const & conns);
+int compute_wire_lengths(connections_t const & conns, Geometry const & geometry = default_geometry());
+
+/* Same as above, only looking at the units that have at least one input
+ * connected, so that it does not depend on the size of the array.
+ */
+int compute_wire_lengths(connections_t const & conns, std::vector<int> const & wired_units,
+                         Geometry const & geometry = default_geometry());
 
 // Implement logic described above for one wire
-int compute_one_wire_length(std::vector<int> const & wire);
+int compute_one_wire_length(std::vector<int> const & wire, Geometry const & geometry = default_geometry());
+
+/* Score of a walker, shared by the search engines: inputs connected, distance
+ * of the closest unit outputs to the target, recovery of the whole function
+ * and the speed prior on wire lengths, which are returned as well.
+ */
+ScoreOutput score_walker(Walker * walker, ScoringPlan const & plan, ScoringParams const & params,
+                         propagation::PropagationLimits const & limits,
+                         propagation::PropagationStats * stats, int * wire_lengths);
 
 }
 
@@ -0,0 +1,308 @@
+#include "serialization.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace serialization;
+
+// "CPW" and the version of the encoding
+static const uint64_t WALKERS_MAGIC = 0x43505701;
+
+// "CPC" and the version of the checkpoint format
+static const uint64_t CHECKPOINT_MAGIC = 0x43504301;
+
+// sanity bound on decoded geometries, so that garbage does not allocate gigabytes
+static const uint64_t MAX_UNIT_COUNT = 1 << 20;
+
+void serialization::put_varint(uint64_t value, bytes_t *bytes) {
+  while(value >= 0x80) {
+    bytes->push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  bytes->push_back(value);
+}
+
+bool serialization::get_varint(const bytes_t &bytes, std::size_t *offset, uint64_t *value) {
+  *value = 0;
+  for(int shift = 0; shift < 64; shift += 7) {
+    if(*offset >= bytes.size()) {
+      return false;
+    }
+
+    uint8_t byte = bytes[(*offset) ++];
+    *value |= uint64_t(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void serialization::put_double(double value, bytes_t *bytes) {
+  uint64_t bits = 0;
+  memcpy(& bits, & value, sizeof(bits));
+  for(int byte_id = 0; byte_id < 8; ++ byte_id) {
+    bytes->push_back(bits >> (8 * byte_id));
+  }
+}
+
+bool serialization::get_double(const bytes_t &bytes, std::size_t *offset, double *value) {
+  if(*offset + 8 > bytes.size()) {
+    return false;
+  }
+
+  uint64_t bits = 0;
+  for(int byte_id = 0; byte_id < 8; ++ byte_id) {
+    bits |= uint64_t(bytes[(*offset) ++]) << (8 * byte_id);
+  }
+  memcpy(value, & bits, sizeof(bits));
+  return true;
+}
+
+void serialization::put_string(const std::string &value, bytes_t *bytes) {
+  put_varint(value.size(), bytes);
+  bytes->insert(bytes->end(), value.begin(), value.end());
+}
+
+bool serialization::get_string(const bytes_t &bytes, std::size_t *offset, std::string *value) {
+  uint64_t length = 0;
+  if(! get_varint(bytes, offset, & length) || length > bytes.size() - *offset) {
+    return false;
+  }
+
+  value->assign(bytes.begin() + *offset, bytes.begin() + *offset + length);
+  *offset += length;
+  return true;
+}
+
+void serialization::encode_walker(const Walker &walker, bytes_t *bytes) {
+  auto & geometry = walker.geometry();
+  put_varint(geometry.row_count(), bytes);
+  put_varint(geometry.coll_count(), bytes);
+  for(int coll_type : geometry.coll_types) {
+    put_varint(coll_type, bytes);
+  }
+
+  // a unit is wired if at least one of its inputs is connected
+  auto & wired_units = walker.wired_units();
+  int input_count = 0;
+  for(int unit_id : wired_units) {
+    input_count += (walker.input(unit_id * 2) != -1) + (walker.input(unit_id * 2 + 1) != -1);
+  }
+
+  put_varint(input_count, bytes);
+  for(int unit_id : wired_units) {
+    for(int input_id = unit_id * 2; input_id < unit_id * 2 + 2; ++ input_id) {
+      if(walker.input(input_id) != -1) {
+        put_varint(input_id, bytes);
+        put_varint(walker.input(input_id), bytes);
+      }
+    }
+  }
+}
+
+bool serialization::decode_walker(const bytes_t &bytes, std::size_t *offset, Walker *walker) {
+  uint64_t row_count = 0;
+  uint64_t coll_count = 0;
+  if(! get_varint(bytes, offset, & row_count) || ! get_varint(bytes, offset, & coll_count) ||
+     row_count == 0 || coll_count == 0 || row_count > MAX_UNIT_COUNT || coll_count > MAX_UNIT_COUNT ||
+     row_count * coll_count > MAX_UNIT_COUNT) {
+    return false;
+  }
+
+  Geometry geometry{row_count, vector<int>(coll_count)};
+  for(auto & coll_type : geometry.coll_types) {
+    uint64_t value = 0;
+    if(! get_varint(bytes, offset, & value) || value > 2) {
+      return false;
+    }
+    coll_type = value;
+  }
+
+  uint64_t input_count = 0;
+  if(! get_varint(bytes, offset, & input_count) || input_count > geometry.conn_input_count()) {
+    return false;
+  }
+
+  Walker decoded(geometry);
+  for(uint64_t cid = 0; cid < input_count; ++ cid) {
+    uint64_t input_id = 0;
+    uint64_t unit_id = 0;
+    if(! get_varint(bytes, offset, & input_id) || ! get_varint(bytes, offset, & unit_id) ||
+       input_id >= geometry.conn_input_count() || unit_id >= geometry.conn_unit_count()) {
+      return false;
+    }
+    decoded.rewire(input_id, unit_id);
+  }
+
+  *walker = std::move(decoded);
+  return true;
+}
+
+void serialization::encode_walkers(const std::vector<Walker> &walkers, bytes_t *bytes) {
+  put_varint(WALKERS_MAGIC, bytes);
+  put_varint(walkers.size(), bytes);
+  for(auto & walker : walkers) {
+    encode_walker(walker, bytes);
+  }
+}
+
+bool serialization::decode_walkers(const bytes_t &bytes, std::vector<Walker> *walkers) {
+  size_t offset = 0;
+  uint64_t magic = 0;
+  uint64_t walker_count = 0;
+  if(! get_varint(bytes, & offset, & magic) || magic != WALKERS_MAGIC ||
+     ! get_varint(bytes, & offset, & walker_count) || walker_count > bytes.size()) {
+    return false;
+  }
+
+  walkers->resize(walker_count);
+  for(auto & walker : *walkers) {
+    if(! decode_walker(bytes, & offset, & walker)) {
+      walkers->clear();
+      return false;
+    }
+  }
+  return offset == bytes.size();
+}
+
+void serialization::encode_checkpoint(const SearchCheckpoint &checkpoint, bytes_t *bytes) {
+  put_varint(CHECKPOINT_MAGIC, bytes);
+  put_varint(checkpoint.next_iteration, bytes);
+  put_varint(checkpoint.iteration_count, bytes);
+  put_string(checkpoint.random_state, bytes);
+
+  put_varint(checkpoint.walkers.size(), bytes);
+  for(auto & walker : checkpoint.walkers) {
+    encode_walker(walker, bytes);
+  }
+
+  put_varint(checkpoint.best_circuits.size(), bytes);
+  for(auto & circuit : checkpoint.best_circuits) {
+    put_double(circuit.score, bytes);
+    put_varint(circuit.wire_length, bytes);
+    put_varint(circuit.function_recovered, bytes);
+
+    // -1 for disconnected inputs is stored as 0
+    put_varint(circuit.conns.size(), bytes);
+    for(int unit_id : circuit.conns) {
+      put_varint(unit_id + 1, bytes);
+    }
+  }
+}
+
+bool serialization::decode_checkpoint(const bytes_t &bytes, SearchCheckpoint *checkpoint) {
+  size_t offset = 0;
+  uint64_t magic = 0;
+  uint64_t next_iteration = 0;
+  uint64_t iteration_count = 0;
+  uint64_t walker_count = 0;
+  if(! get_varint(bytes, & offset, & magic) || magic != CHECKPOINT_MAGIC ||
+     ! get_varint(bytes, & offset, & next_iteration) ||
+     ! get_varint(bytes, & offset, & iteration_count) ||
+     ! get_string(bytes, & offset, & checkpoint->random_state) ||
+     ! get_varint(bytes, & offset, & walker_count) || walker_count > bytes.size()) {
+    return false;
+  }
+  checkpoint->next_iteration = next_iteration;
+  checkpoint->iteration_count = iteration_count;
+
+  checkpoint->walkers.resize(walker_count);
+  for(auto & walker : checkpoint->walkers) {
+    if(! decode_walker(bytes, & offset, & walker)) {
+      return false;
+    }
+  }
+
+  // circuits have no geometry of their own, they were found on that of the walkers
+  uint64_t circuit_count = 0;
+  if(! get_varint(bytes, & offset, & circuit_count) || circuit_count > bytes.size() ||
+     (circuit_count > 0 && checkpoint->walkers.empty())) {
+    return false;
+  }
+  uint64_t max_value = 0;
+  uint64_t input_count = 0;
+  if(circuit_count > 0) {
+    Geometry const & geometry = checkpoint->walkers.front().geometry();
+    max_value = geometry.array_input_id() + 1;
+    input_count = geometry.conn_input_count();
+  }
+
+  checkpoint->best_circuits.resize(circuit_count);
+  for(auto & circuit : checkpoint->best_circuits) {
+    uint64_t wire_length = 0;
+    uint64_t function_recovered = 0;
+    uint64_t conn_count = 0;
+    if(! get_double(bytes, & offset, & circuit.score) ||
+       ! get_varint(bytes, & offset, & wire_length) ||
+       ! get_varint(bytes, & offset, & function_recovered) ||
+       ! get_varint(bytes, & offset, & conn_count) || conn_count != input_count) {
+      return false;
+    }
+    circuit.wire_length = wire_length;
+    circuit.function_recovered = function_recovered != 0;
+
+    circuit.conns.resize(conn_count);
+    for(auto & unit_id : circuit.conns) {
+      uint64_t value = 0;
+      if(! get_varint(bytes, & offset, & value) || value > max_value) {
+        return false;
+      }
+      unit_id = (int) value - 1;
+    }
+  }
+
+  return offset == bytes.size();
+}
+
+bool serialization::write_file_atomically(const std::string &path, const bytes_t &bytes) {
+  string temp_path = path + ".tmp";
+
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) {
+    cerr << "ERROR: Cannot create file: " << temp_path << endl;
+    return false;
+  }
+
+  size_t written = 0;
+  while(written < bytes.size()) {
+    ssize_t count = write(fd, bytes.data() + written, bytes.size() - written);
+    if(count <= 0) {
+      cerr << "ERROR: Cannot write file: " << temp_path << endl;
+      close(fd);
+      return false;
+    }
+    written += count;
+  }
+
+  // the data must be on disk before the rename makes it visible
+  bool synced = fsync(fd) == 0;
+  close(fd);
+
+  if(! synced || rename(temp_path.c_str(), path.c_str()) != 0) {
+    cerr << "ERROR: Cannot replace file: " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+bool serialization::read_file(const std::string &path, bytes_t *bytes) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd == -1) {
+    return false;
+  }
+
+  bytes->clear();
+  uint8_t buffer[4096];
+  ssize_t count = 0;
+  while((count = read(fd, buffer, sizeof(buffer))) > 0) {
+    bytes->insert(bytes->end(), buffer, buffer + count);
+  }
+  close(fd);
+
+  return count == 0;
+}
@@ -0,0 +1,70 @@
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "walker.h"
+#include "best_tracker.h"
+
+namespace serialization {
+
+typedef std::vector<uint8_t> bytes_t;
+
+/* Compact binary encoding of walkers, independent of the host byte order.
+ *
+ * A walker is stored as its geometry followed by the connected inputs only,
+ * as (input id, unit id) pairs. All integers are LEB128 varints, so a walker
+ * on the default array with a few dozen connections takes around 100 bytes.
+ * Caches are not stored, they are rebuilt on first use.
+ */
+void encode_walker(Walker const & walker, bytes_t * bytes);
+
+// decode the walker starting at *offset and move the offset past it, false
+// if the bytes are truncated or do not describe a valid walker
+bool decode_walker(bytes_t const & bytes, std::size_t * offset, Walker * walker);
+
+// a batch of walkers behind a magic number and a count
+void encode_walkers(std::vector<Walker> const & walkers, bytes_t * bytes);
+bool decode_walkers(bytes_t const & bytes, std::vector<Walker> * walkers);
+
+/* Everything needed to resume a stochastic search where it stopped, given a
+ * search created with the same polynomial, parameters and geometry.
+ */
+struct SearchCheckpoint {
+  // first iteration left to run, out of iteration_count
+  int next_iteration;
+  int iteration_count;
+
+  // state of the main random engine, as written by operator<<
+  std::string random_state;
+
+  std::vector<Walker> walkers;
+  std::vector<BestCircuit> best_circuits;
+};
+
+// a checkpoint behind its own magic number and the version of the format
+void encode_checkpoint(SearchCheckpoint const & checkpoint, bytes_t * bytes);
+bool decode_checkpoint(bytes_t const & bytes, SearchCheckpoint * checkpoint);
+
+void put_varint(uint64_t value, bytes_t * bytes);
+bool get_varint(bytes_t const & bytes, std::size_t * offset, uint64_t * value);
+
+// doubles are stored bit for bit, so that they read back exactly
+void put_double(double value, bytes_t * bytes);
+bool get_double(bytes_t const & bytes, std::size_t * offset, double * value);
+
+void put_string(std::string const & value, bytes_t * bytes);
+bool get_string(bytes_t const & bytes, std::size_t * offset, std::string * value);
+
+/* Replace the file at path with the given bytes, so that readers and crashes
+ * see either the old or the new content in full: write a temporary file next
+ * to it, flush it to disk and rename it over the old one.
+ */
+bool write_file_atomically(std::string const & path, bytes_t const & bytes);
+
+bool read_file(std::string const & path, bytes_t * bytes);
+
+}
+
+#endif // SERIALIZATION_H
@@ -0,0 +1,328 @@
+#include "solution_database.h"
+#include "propagation.h"
+#include "serialization.h"
+
+#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace serialization;
+
+// "CPS" and the version of the log format
+static const uint32_t SOLUTIONS_MAGIC = 0x43505301;
+
+// circuits kept in the index for each target, the log keeps everything
+static const size_t SOLUTIONS_PER_TARGET = 10;
+
+// records are behind a fixed size length and checksum
+static const size_t RECORD_HEADER_SIZE = 8;
+
+static void put_uint32(uint32_t value, uint8_t * bytes) {
+  for(int pos = 0; pos < 4; ++ pos) {
+    bytes[pos] = (value >> (8 * pos)) & 0xff;
+  }
+}
+
+static uint32_t get_uint32(const uint8_t * bytes) {
+  uint32_t value = 0;
+  for(int pos = 0; pos < 4; ++ pos) {
+    value |= (uint32_t) bytes[pos] << (8 * pos);
+  }
+  return value;
+}
+
+// FNV-1a, enough to tell a torn record from a complete one
+static uint32_t checksum(const uint8_t * bytes, size_t size) {
+  uint32_t hash = 2166136261u;
+  for(size_t pos = 0; pos < size; ++ pos) {
+    hash = (hash ^ bytes[pos]) * 16777619u;
+  }
+  return hash;
+}
+
+// the geometry and the target in canonical order
+static void encode_key(poly_t const & target, Geometry const & geometry, bytes_t * bytes) {
+  poly_t canonical = target;
+  propagation::sort_canonical(& canonical);
+
+  put_varint(geometry.rows, bytes);
+  put_varint(geometry.coll_count(), bytes);
+  for(int coll_type : geometry.coll_types) {
+    put_varint(coll_type, bytes);
+  }
+  put_varint(canonical.size(), bytes);
+  for(int power : canonical) {
+    put_varint((uint64_t) power, bytes);
+  }
+}
+
+// move the offset past a key, false if the bytes do not hold one
+static bool skip_key(bytes_t const & bytes, size_t * offset) {
+  uint64_t value = 0;
+  uint64_t coll_count = 0;
+  uint64_t term_count = 0;
+  if(! get_varint(bytes, offset, & value) || ! get_varint(bytes, offset, & coll_count)) {
+    return false;
+  }
+  for(uint64_t coll = 0; coll < coll_count; ++ coll) {
+    if(! get_varint(bytes, offset, & value)) {
+      return false;
+    }
+  }
+  if(! get_varint(bytes, offset, & term_count)) {
+    return false;
+  }
+  for(uint64_t term = 0; term < term_count; ++ term) {
+    if(! get_varint(bytes, offset, & value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void encode_circuit(BestCircuit const & circuit, bytes_t * bytes) {
+  put_double(circuit.score, bytes);
+  put_varint(circuit.wire_length, bytes);
+  put_varint(circuit.function_recovered ? 1 : 0, bytes);
+  put_varint(circuit.conns.size(), bytes);
+  for(int unit_id : circuit.conns) {
+    put_varint(unit_id + 1, bytes);
+  }
+}
+
+static bool decode_circuit(bytes_t const & bytes, size_t * offset, BestCircuit * circuit) {
+  uint64_t wire_length = 0;
+  uint64_t recovered = 0;
+  uint64_t conn_count = 0;
+  if(! get_double(bytes, offset, & circuit->score) || ! get_varint(bytes, offset, & wire_length) ||
+     ! get_varint(bytes, offset, & recovered) || ! get_varint(bytes, offset, & conn_count) ||
+     conn_count > bytes.size()) {
+    return false;
+  }
+  circuit->wire_length = wire_length;
+  circuit->function_recovered = recovered != 0;
+
+  circuit->conns.resize(conn_count);
+  for(auto & unit_id : circuit->conns) {
+    uint64_t value = 0;
+    if(! get_varint(bytes, offset, & value)) {
+      return false;
+    }
+    unit_id = (int) value - 1;
+  }
+  return true;
+}
+
+SolutionDatabase::SolutionDatabase()
+  : fd(-1),
+    record_count(0) {
+}
+
+SolutionDatabase::~SolutionDatabase() {
+  close();
+}
+
+bool SolutionDatabase::open(const std::string &path) {
+  close();
+
+  lock_guard<mutex> guard(lock);
+  this->path = path;
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat file_stat;
+  if(fd == -1 || fstat(fd, & file_stat) != 0) {
+    cerr << "ERROR: Cannot open solution database: " << path << endl;
+    if(fd != -1) {
+      ::close(fd);
+      fd = -1;
+    }
+    return false;
+  }
+
+  size_t file_size = file_stat.st_size;
+  if(file_size == 0) {
+    uint8_t magic[4];
+    put_uint32(SOLUTIONS_MAGIC, magic);
+    if(write(fd, magic, sizeof(magic)) != sizeof(magic)) {
+      cerr << "ERROR: Cannot write solution database: " << path << endl;
+      ::close(fd);
+      fd = -1;
+      return false;
+    }
+    return true;
+  }
+
+  const uint8_t * data = nullptr;
+  if(file_size >= 4) {
+    void * address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(address != MAP_FAILED) {
+      data = static_cast<const uint8_t *>(address);
+    }
+  }
+  if(data == nullptr || get_uint32(data) != SOLUTIONS_MAGIC) {
+    cerr << "ERROR: Not a solution database: " << path << endl;
+    if(data != nullptr) {
+      munmap(const_cast<uint8_t *>(data), file_size);
+    }
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  // the index is rebuilt from the records, up to the first incomplete one
+  madvise(const_cast<uint8_t *>(data), file_size, MADV_SEQUENTIAL);
+  size_t offset = 4;
+  bytes_t payload;
+  while(offset + RECORD_HEADER_SIZE <= file_size) {
+    size_t payload_size = get_uint32(data + offset);
+    const uint8_t * payload_data = data + offset + RECORD_HEADER_SIZE;
+    if(payload_size > file_size - offset - RECORD_HEADER_SIZE ||
+       checksum(payload_data, payload_size) != get_uint32(data + offset + 4)) {
+      break;
+    }
+
+    payload.assign(payload_data, payload_data + payload_size);
+    size_t payload_offset = 0;
+    BestCircuit circuit;
+    if(! skip_key(payload, & payload_offset)) {
+      break;
+    }
+    string key(payload.begin(), payload.begin() + payload_offset);
+    if(! decode_circuit(payload, & payload_offset, & circuit) || payload_offset != payload_size) {
+      break;
+    }
+
+    index_circuit(key, circuit);
+    ++ record_count;
+    offset += RECORD_HEADER_SIZE + payload_size;
+  }
+  munmap(const_cast<uint8_t *>(data), file_size);
+
+  // cut off a record torn by a crash, so that new records follow complete ones
+  if(offset != file_size) {
+    cerr << "ERROR: Dropping " << file_size - offset << " bytes of incomplete records from: "
+         << path << endl;
+    if(ftruncate(fd, offset) != 0) {
+      cerr << "ERROR: Cannot truncate solution database: " << path << endl;
+      ::close(fd);
+      fd = -1;
+      index.clear();
+      record_count = 0;
+      return false;
+    }
+  }
+  lseek(fd, offset, SEEK_SET);
+  return true;
+}
+
+void SolutionDatabase::close() {
+  lock_guard<mutex> guard(lock);
+  if(fd != -1) {
+    ::close(fd);
+    fd = -1;
+  }
+  index.clear();
+  record_count = 0;
+}
+
+std::size_t SolutionDatabase::size() const {
+  lock_guard<mutex> guard(lock);
+  return record_count;
+}
+
+// circuits that recover the target first, by shorter wires since their score
+// depends on the parameters of the search that found them, then the others by
+// their score, as the wires of a circuit that does not work say little
+static bool ranks_before(BestCircuit const & c1, BestCircuit const & c2) {
+  if(c1.function_recovered != c2.function_recovered) {
+    return c1.function_recovered;
+  }
+  if(c1.function_recovered) {
+    return c1.wire_length < c2.wire_length;
+  }
+  return c1.score > c2.score;
+}
+
+bool SolutionDatabase::index_circuit(const std::string &key, const BestCircuit &circuit) {
+  auto & circuits = index[key];
+
+  auto same = find_if(circuits.begin(), circuits.end(), [&circuit](BestCircuit const & known) {
+    return known.conns == circuit.conns;
+  });
+  if(same != circuits.end()) {
+    // only different parameters or limits can change how the same circuit ranks
+    if(! ranks_before(circuit, *same)) {
+      return false;
+    }
+    circuits.erase(same);
+  }
+
+  if(circuits.size() == SOLUTIONS_PER_TARGET && ! ranks_before(circuit, circuits.back())) {
+    return false;
+  }
+
+  auto position = upper_bound(circuits.begin(), circuits.end(), circuit, ranks_before);
+  circuits.insert(position, circuit);
+  if(circuits.size() > SOLUTIONS_PER_TARGET) {
+    circuits.pop_back();
+  }
+  return true;
+}
+
+bool SolutionDatabase::add(const poly_t &target, const Geometry &geometry, const BestCircuit &circuit) {
+  bytes_t key_bytes;
+  encode_key(target, geometry, & key_bytes);
+  string key(key_bytes.begin(), key_bytes.end());
+
+  lock_guard<mutex> guard(lock);
+  if(fd == -1) {
+    return false;
+  }
+
+  // the index only changes for good once the record is in the log
+  auto & circuits = index[key];
+  vector<BestCircuit> previous = circuits;
+  if(! index_circuit(key, circuit)) {
+    return false;
+  }
+
+  bytes_t record(RECORD_HEADER_SIZE);
+  record.insert(record.end(), key_bytes.begin(), key_bytes.end());
+  encode_circuit(circuit, & record);
+
+  size_t payload_size = record.size() - RECORD_HEADER_SIZE;
+  put_uint32(payload_size, record.data());
+  put_uint32(checksum(record.data() + RECORD_HEADER_SIZE, payload_size), record.data() + 4);
+
+  // a single write, so that a crash leaves at most one torn record at the end
+  if(write(fd, record.data(), record.size()) != (ssize_t) record.size()) {
+    cerr << "ERROR: Cannot append to solution database: " << path << endl;
+    circuits = std::move(previous);
+    return false;
+  }
+  ++ record_count;
+  return true;
+}
+
+bool SolutionDatabase::find(const poly_t &target, const Geometry &geometry, std::vector<BestCircuit> *circuits) const {
+  bytes_t key_bytes;
+  encode_key(target, geometry, & key_bytes);
+
+  lock_guard<mutex> guard(lock);
+  auto found = index.find(string(key_bytes.begin(), key_bytes.end()));
+  if(found == index.end() || found->second.empty()) {
+    circuits->clear();
+    return false;
+  }
+  *circuits = found->second;
+  return true;
+}
+
+bool SolutionDatabase::sync() {
+  lock_guard<mutex> guard(lock);
+  return fd != -1 && fdatasync(fd) == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef SOLUTIONDATABASE_H
+#define SOLUTIONDATABASE_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "definitions.h"
+#include "best_tracker.h"
+
+/* The best circuits found for each target polynomial, kept on disk across
+ * runs so that a target solved before is answered by a lookup.
+ *
+ * The file is an append-only log: a magic number, then one record per
+ * circuit with its target in canonical order, the geometry, the score, the
+ * wire length and whether it recovers the function. Each record is behind
+ * its length and a checksum, so a record torn by a crash is detected and
+ * cut off the next time the file is opened.
+ *
+ * Opening maps the file and rebuilds an index in memory with the best
+ * circuits of each target and geometry, queries only touch the index.
+ * It is safe to add and find from several threads.
+ *
+ * Scores depend on the scoring parameters and limits of the search that
+ * found a circuit, so circuits that recover the target come first, ranked on
+ * what does not: the shortest wires. The others follow by their stored
+ * score, the only measure of how close they came. Searches starting from
+ * known circuits score them again with their own parameters.
+ */
+class SolutionDatabase {
+  std::string path;
+  int fd;
+
+  mutable std::mutex lock;
+
+  // best ranked circuits first, for each target and geometry encoded as a key
+  std::unordered_map<std::string, std::vector<BestCircuit>> index;
+  std::size_t record_count;
+
+  // keep the circuit in the index if it is among the best of its key, false if not
+  bool index_circuit(std::string const & key, BestCircuit const & circuit);
+
+public:
+  SolutionDatabase();
+  ~SolutionDatabase();
+
+  SolutionDatabase(SolutionDatabase const &) = delete;
+  SolutionDatabase & operator=(SolutionDatabase const &) = delete;
+
+  // open or create the log at path and rebuild the index from it
+  bool open(std::string const & path);
+  void close();
+
+  bool is_open() const { return fd != -1; }
+
+  // number of records in the log, including circuits that were outranked since
+  std::size_t size() const;
+
+  /* Append the circuit for the target, unless the database already has it
+   * or has enough better ranked ones. Returns true if it was stored.
+   */
+  bool add(poly_t const & target, Geometry const & geometry, BestCircuit const & circuit);
+
+  // the best circuits known for the target on the geometry, best ranked
+  // first, false if there are none
+  bool find(poly_t const & target, Geometry const & geometry, std::vector<BestCircuit> * circuits) const;
+
+  // flush the appended records to disk
+  bool sync();
+};
+
+#endif // SOLUTIONDATABASE_H
@@ -1,240 +1,675 @@
 #include "stochastic_search.h"
 #include "utils/disjoint_sets.h"
 #include "propagation.h"
+#include "fingerprint.h"
+#include "serialization.h"
+#include "recipes.h"
 
 #include <iostream>
+#include <sstream>
 #include <limits>
 #include <algorithm>
-#include <deque>
 #include <cmath>
 #include <iomanip>
 #include <cassert>
+#include <atomic>
 
 using namespace std;
 using namespace scoring;
 using namespace propagation;
-
-StochasticSearch::StochasticSearch(const vector<int> &polynomial, int walker_count, ScoringParams params)
-  : random_generator(random_device{}()),
-//  : random_generator(42), // for reproducible debugging
-    dist_walkers(0, walker_count - 1),
-    dist_inputs(0, CONN_INPUT_COUNT - 1),
+using namespace fingerprint;
+using namespace serialization;
+
+// walkers per task when scoring and injecting noise on several threads
+static const int SCORE_CHUNK_SIZE = 4;
+static const int NOISE_CHUNK_SIZE = 4;
+static const int PIPELINE_CHUNK_SIZE = 2;
+
+// circuits kept by the best tracker of a search
+static const int BEST_CIRCUIT_COUNT = 10;
+
+// rows tried for each recipe before a warm started walker goes without it
+static const int WARM_START_ATTEMPTS = 4;
+
+StochasticSearch::StochasticSearch(const vector<int> &polynomial, int walker_count, ScoringParams params,
+                                   const Geometry &geometry)
+  : geometry(geometry),
+    random_generator(random_device{}()),
+//    random_generator(42), // for reproducible debugging
+    dist_inputs(0, geometry.conn_input_count() - 1),
     params(params),
-    poly(polynomial) {
+    poly(polynomial),
+    limits(DEFAULT_LIMITS),
+    limit_stats{0, 0},
+    use_fingerprint_prefilter(false),
+    best_tracker(make_shared<BestTracker>(BEST_CIRCUIT_COUNT)),
+    verbose(true),
+    pipeline_batch_count(0),
+    checkpoint_interval(0),
+    resume_iteration(0),
+    resume_iteration_count(0),
+    population_sync_interval(0) {
   initialize_walkers(walker_count);
 
   // make sure input polynomial is in canonical form i.e. higher powers at front
   sort_canonical(& poly);
+
+  plan = make_scoring_plan(poly, limits.max_degree);
+  target_fingerprint = compute_poly_fingerprint(poly);
 }
 
 void StochasticSearch::train(int iteration_count, int cycle_count, int clone_count, NoiseParams const & noise_cfg) {
-  for(int iter_id = 0; iter_id < iteration_count; ++ iter_id) {
+  if(pool) {
+    pool->reset_statistics();
+  }
+
+  // pick up where a checkpoint or a population file left off
+  int first_iteration = 0;
+  if(resume_iteration > 0) {
+    if(resume_iteration_count == iteration_count) {
+      first_iteration = resume_iteration;
+    } else {
+      cerr << "ERROR: Search was saved for " << resume_iteration_count
+           << " iterations, starting over" << endl;
+    }
+    resume_iteration = 0;
+  }
+  if(first_iteration == 0) {
+    seed_from_solutions();
+  }
+
+  for(int iter_id = first_iteration; iter_id < iteration_count; ++ iter_id) {
+    train_iteration(iter_id, iteration_count, cycle_count, clone_count, noise_cfg);
+
+    if(checkpoint_writer && (iter_id + 1) % checkpoint_interval == 0) {
+      write_checkpoint(iter_id + 1, iteration_count);
+    }
+    // storing sweeps the whole population, so it only happens before a sync
+    if(population_file && ((iter_id + 1) % population_sync_interval == 0 || iter_id + 1 == iteration_count)) {
+      store_population(iter_id + 1, iteration_count);
+      population_file->sync();
+    }
+  }
+
+  record_solutions();
+
+  if(pool && verbose) {
+    auto & stats = pool->statistics();
+    for(int thread_id = 0; thread_id < stats.size(); ++ thread_id) {
+      cout << "Thread " << thread_id
+           << "\tbusy: " << setprecision(3) << stats[thread_id].busy_seconds << " s"
+           << ", idle: " << stats[thread_id].idle_seconds << " s"
+           << ", " << stats[thread_id].task_count << " tasks"
+           << ", " << stats[thread_id].steal_count << " stolen" << endl;
+    }
+  }
+}
+
+ScoreOutput StochasticSearch::train_iteration(int iter_id, int iteration_count, int cycle_count, int clone_count,
+                                              NoiseParams const & noise_cfg) {
+  if(verbose) {
     cout << "Performing iteration [ " << iter_id + 1
          << " / " << iteration_count << " ]"
          << endl;
+  }
+
+  ScoreOutput best_score = {0, numeric_limits<double>::lowest()};
+  limit_stats = {0, 0};
 
-    ScoreOutput best_score = {0, numeric_limits<double>::lowest()};
+  double iter_fraction = (double) (iter_id + 1) / iteration_count;
 
+  // each batch needs two walkers for selection
+  bool pipelined = pipeline_batch_count > 0 && walkers.size() >= 2 * pipeline_batch_count;
+  if(pipelined) {
+    best_score = perform_pipelined_cycles(iter_fraction, cycle_count, clone_count, noise_cfg);
+  } else {
     for(int cycle_id = 0; cycle_id < cycle_count; ++ cycle_id) {
-      auto score_out = perform_cycle(iter_id, cycle_id, clone_count);
+      auto score_out = perform_cycle(clone_count);
       if(best_score.best_score < score_out.best_score) {
         best_score = score_out;
       }
     }
+  }
 
+  if(verbose) {
     cout << "\tbest score this iteration: "
          << setprecision(2)
          << best_score.best_score << endl
          << "\tfunction was recovered "
          << best_score.times_function_recovered
-         << " times" << endl;
+         << " times" << endl
+         << "\tunit outputs over the degree limit: "
+         << limit_stats.degree_limit_hits
+         << ", over the term limit: "
+         << limit_stats.term_limit_hits << endl;
+  }
 
-    // inject random noise into walkers
-    double iter_fraction = (double) (iter_id + 1) / iteration_count;
+  // inject random noise into walkers, pipelined cycles already did
+  if(! pipelined) {
     inject_noise(iter_fraction, noise_cfg);
   }
+
+  return best_score;
+}
+
+void StochasticSearch::set_seed(unsigned seed) {
+  random_generator.seed(seed);
+}
+
+void StochasticSearch::set_verbose(bool enabled) {
+  verbose = enabled;
+}
+
+void StochasticSearch::set_thread_count(int thread_count) {
+  if(thread_count > 1) {
+    pool.reset(new utils::work_stealing_pool(thread_count));
+  } else {
+    pool.reset();
+  }
+}
+
+void StochasticSearch::set_checkpoint(const std::string &path, int interval) {
+  checkpoint_path = path;
+  checkpoint_interval = max(1, interval);
+
+  if(path.empty()) {
+    checkpoint_writer.reset();
+  } else if(! checkpoint_writer) {
+    checkpoint_writer.reset(new CheckpointWriter());
+  }
+}
+
+void StochasticSearch::flush_checkpoints() {
+  if(checkpoint_writer) {
+    checkpoint_writer->flush();
+  }
+}
+
+void StochasticSearch::write_checkpoint(int next_iteration, int iteration_count) {
+  auto checkpoint = make_shared<SearchCheckpoint>();
+  checkpoint->next_iteration = next_iteration;
+  checkpoint->iteration_count = iteration_count;
+
+  ostringstream random_state;
+  random_state << random_generator;
+  checkpoint->random_state = random_state.str();
+
+  // copies of walkers share their connections copy-on-write, so this is cheap
+  // and training goes on while the writer thread encodes them
+  checkpoint->walkers = walkers;
+  checkpoint->best_circuits = *best_tracker->snapshot();
+
+  checkpoint_writer->submit(checkpoint_path, [checkpoint](bytes_t * bytes) {
+    encode_checkpoint(*checkpoint, bytes);
+  });
+}
+
+bool StochasticSearch::resume(const std::string &path) {
+  bytes_t bytes;
+  SearchCheckpoint checkpoint;
+  if(! read_file(path, & bytes) || ! decode_checkpoint(bytes, & checkpoint)) {
+    cerr << "ERROR: Cannot read checkpoint: " << path << endl;
+    return false;
+  }
+
+  if(checkpoint.walkers.size() != walkers.size()) {
+    cerr << "ERROR: Checkpoint has " << checkpoint.walkers.size() << " walkers instead of "
+         << walkers.size() << endl;
+    return false;
+  }
+  for(auto & walker : checkpoint.walkers) {
+    if(walker.geometry() != geometry) {
+      cerr << "ERROR: Checkpoint is for a different geometry" << endl;
+      return false;
+    }
+  }
+
+  istringstream random_state(checkpoint.random_state);
+  random_state >> random_generator;
+  if(random_state.fail()) {
+    cerr << "ERROR: Checkpoint has an invalid random engine state" << endl;
+    return false;
+  }
+
+  walkers = std::move(checkpoint.walkers);
+  last_scores.clear();
+  for(auto & circuit : checkpoint.best_circuits) {
+    best_tracker->offer(circuit);
+  }
+
+  resume_iteration = checkpoint.next_iteration;
+  resume_iteration_count = checkpoint.iteration_count;
+  return true;
+}
+
+bool StochasticSearch::set_population_file(const std::string &path, int sync_interval) {
+  population_file.reset();
+  population_sync_interval = max(1, sync_interval);
+  if(path.empty()) {
+    return true;
+  }
+
+  unique_ptr<PopulationFile> file(new PopulationFile());
+  if(! file->open(path, geometry, walkers.size())) {
+    return false;
+  }
+
+  // records are swept in walker order both ways
+  file->advise_sequential();
+
+  if(file->was_restored()) {
+    vector<Walker> loaded(walkers.size(), Walker(geometry));
+    atomic<bool> valid(true);
+    run_parallel(walkers.size(), NOISE_CHUNK_SIZE, [&](int wid, PropagationStats *) {
+      if(! file->load(wid, & loaded[wid])) {
+        valid = false;
+      }
+    });
+    if(! valid) {
+      cerr << "ERROR: Invalid walker in population file: " << path << endl;
+      return false;
+    }
+    walkers = std::move(loaded);
+    last_scores.clear();
+
+    // the noise schedule goes on from the stored iteration, unless the run had ended
+    if(file->iteration() < file->iteration_count()) {
+      resume_iteration = file->iteration();
+      resume_iteration_count = file->iteration_count();
+    }
+  }
+
+  population_file = std::move(file);
+  if(! population_file->was_restored()) {
+    store_population(0, 0);
+  }
+  return true;
+}
+
+void StochasticSearch::store_population(int iteration, int iteration_count) {
+  run_parallel(walkers.size(), NOISE_CHUNK_SIZE, [&](int wid, PropagationStats *) {
+    population_file->store(wid, walkers[wid]);
+  });
+  population_file->set_iteration(iteration, iteration_count);
+}
+
+void StochasticSearch::set_solution_database(std::shared_ptr<SolutionDatabase> database) {
+  solution_database = database;
+}
+
+void StochasticSearch::set_poly_table(std::shared_ptr<const PolyTable> table) {
+  poly_table = table;
+}
+
+void StochasticSearch::seed_from_solutions() {
+  vector<BestCircuit> circuits;
+  if(solution_database) {
+    solution_database->find(poly, geometry, & circuits);
+  }
+
+  vector<Walker> known;
+  for(auto & circuit : circuits) {
+    known.push_back(Walker(geometry, circuit.conns));
+  }
+
+  Walker constructed(geometry);
+  if(poly_table && poly_table->build_walker(poly, & constructed)) {
+    known.push_back(std::move(constructed));
+  }
+
+  if(known.empty()) {
+    return;
+  }
+  replace_worst_walkers(known);
+
+  if(verbose) {
+    cout << "Starting from " << known.size() << " known circuits" << endl;
+  }
+}
+
+void StochasticSearch::record_solutions() {
+  if(! solution_database) {
+    return;
+  }
+  for(auto & circuit : *best_tracker->snapshot()) {
+    solution_database->add(poly, geometry, circuit);
+  }
+  solution_database->sync();
+}
+
+void StochasticSearch::set_best_tracker(std::shared_ptr<BestTracker> tracker) {
+  best_tracker = tracker;
+}
+
+void StochasticSearch::set_pipeline_batch_count(int batch_count) {
+  pipeline_batch_count = batch_count > 0 ? max(3, batch_count) : 0;
+}
+
+void StochasticSearch::run_parallel(int count, int chunk_size,
+                                    std::function<void(int, PropagationStats *)> const &body) {
+  if(! pool) {
+    for(int index = 0; index < count; ++ index) {
+      body(index, & limit_stats);
+    }
+    return;
+  }
+
+  vector<PropagationStats> thread_stats(pool->size(), {0, 0});
+  pool->parallel_for(count, chunk_size, [&](int begin, int end, int thread_id) {
+    for(int index = begin; index < end; ++ index) {
+      body(index, & thread_stats[thread_id]);
+    }
+  });
+
+  for(auto & stats : thread_stats) {
+    limit_stats.degree_limit_hits += stats.degree_limit_hits;
+    limit_stats.term_limit_hits += stats.term_limit_hits;
+  }
+}
+
+void StochasticSearch::set_propagation_limits(const PropagationLimits &new_limits) {
+  limits = new_limits;
+
+  // the plan tables cover all powers allowed by the limits
+  plan = make_scoring_plan(poly, limits.max_degree);
+}
+
+void StochasticSearch::set_fingerprint_prefilter(bool enabled) {
+  use_fingerprint_prefilter = enabled;
+}
+
+void StochasticSearch::get_best_walkers(int count, std::vector<Walker> *best, std::vector<double> *best_scores) {
+  vector<int> best_ids;
+  vector<double> scores;
+  get_best_walker_ids(count, & best_ids, & scores);
+
+  best->clear();
+  for(int wid : best_ids) {
+    best->push_back(walkers[wid]);
+  }
+
+  if(best_scores != nullptr) {
+    *best_scores = std::move(scores);
+  }
+}
+
+void StochasticSearch::get_best_walker_ids(int count, std::vector<int> *best_ids, std::vector<double> *best_scores) {
+  auto & scores = known_scores();
+
+  vector<int> walker_ids(walkers.size());
+  for(int wid = 0; wid < walkers.size(); ++ wid) {
+    walker_ids[wid] = wid;
+  }
+
+  count = min<int>(count, walkers.size());
+  partial_sort(walker_ids.begin(), walker_ids.begin() + count, walker_ids.end(),
+               [&scores](int wid1, int wid2) { return scores[wid1] > scores[wid2]; });
+
+  best_ids->assign(walker_ids.begin(), walker_ids.begin() + count);
+  best_scores->clear();
+  for(int pos = 0; pos < count; ++ pos) {
+    best_scores->push_back(scores[walker_ids[pos]]);
+  }
+}
+
+void StochasticSearch::replace_walker(int walker_id, const Walker &replacement) {
+  walkers[walker_id].clone_from(replacement);
+  if(! last_scores.empty()) {
+    last_scores[walker_id] = numeric_limits<double>::quiet_NaN();
+  }
+}
+
+void StochasticSearch::replace_worst_walkers(const std::vector<Walker> &replacements) {
+  // walkers from another geometry, e.g. from a misconfigured island, would
+  // wire units that do not exist here
+  vector<Walker const *> accepted;
+  for(auto & replacement : replacements) {
+    if(replacement.geometry() == geometry) {
+      accepted.push_back(& replacement);
+    }
+  }
+  if(accepted.size() != replacements.size()) {
+    cerr << "ERROR: Ignoring " << replacements.size() - accepted.size()
+         << " walkers for a different geometry" << endl;
+  }
+  if(accepted.empty()) {
+    return;
+  }
+
+  auto & scores = known_scores();
+
+  vector<int> walker_ids(walkers.size());
+  for(int wid = 0; wid < walkers.size(); ++ wid) {
+    walker_ids[wid] = wid;
+  }
+
+  int count = min<int>(accepted.size(), walkers.size());
+  partial_sort(walker_ids.begin(), walker_ids.begin() + count, walker_ids.end(),
+               [&scores](int wid1, int wid2) { return scores[wid1] < scores[wid2]; });
+
+  for(int pos = 0; pos < count; ++ pos) {
+    replace_walker(walker_ids[pos], *accepted[pos]);
+  }
 }
 
 void StochasticSearch::initialize_walkers(int walker_count) {
   // initialize wire connections to nil
-  connections_t empty_walker(CONN_INPUT_COUNT, -1);
+  Walker empty_walker(geometry);
 
   // make sure we can reuse the same object by eliminating previous state
   walkers.clear();
   walkers.reserve(walker_count);
   walkers.resize(walker_count, empty_walker);
+  last_scores.clear();
+}
+
+void StochasticSearch::warm_start() {
+  vector<recipes::Recipe> library;
+  recipes::make_recipe_library(poly, geometry, solution_database.get(), limits, & library);
+
+  long placed_count = 0;
+  for(auto & walker : walkers) {
+    walker.reset();
+    for(auto & recipe : library) {
+      uniform_int_distribution<int> dist_rows(0, geometry.rows - recipe.row_count);
+      bool placed = false;
+      for(int attempt = 0; attempt < WARM_START_ATTEMPTS && ! placed; ++ attempt) {
+        placed = recipes::place_recipe(recipe, dist_rows(random_generator), & walker);
+      }
+      placed_count += placed;
+    }
+  }
+  last_scores.clear();
+
+  if(verbose) {
+    cout << "Warm start: " << library.size() << " recipes, " << placed_count
+         << " placed over " << walkers.size() << " walkers" << endl;
+  }
 }
 
-ScoreOutput StochasticSearch::perform_cycle(int iteration_id, int cycle_id, int clone_count) {
+ScoreOutput StochasticSearch::perform_cycle(int clone_count) {
   // first compute the scores of each walker
+  vector<ScoreOutput> score_outs(walkers.size());
+  run_parallel(walkers.size(), SCORE_CHUNK_SIZE, [&](int wid, PropagationStats * stats) {
+    score_outs[wid] = compute_score(wid, stats);
+  });
+
   vector<double> scores(walkers.size(), numeric_limits<double>::lowest());
   ScoreOutput best{0, numeric_limits<double>::lowest()};
 
   for(int wid = 0; wid < walkers.size(); ++ wid) {
-    auto score_out = compute_score(wid);
-    scores[wid] = score_out.best_score;
+    scores[wid] = score_outs[wid].best_score;
 
     if(best.best_score < scores[wid]) {
       best.best_score = scores[wid];
-      best.times_function_recovered = score_out.times_function_recovered;
+      best.times_function_recovered = score_outs[wid].times_function_recovered;
     }
   }
 
   // now perform the cloning
+  last_scores = scores;
+  select_walkers(0, walkers.size(), clone_count, scores, & random_generator);
+
+  return best;
+}
+
+void StochasticSearch::select_walkers(int begin, int end, int clone_count, const std::vector<double> &scores,
+                                      std::mt19937 *generator) {
+  if(end - begin < 2) {
+    return;
+  }
+
+  uniform_int_distribution<int> dist_walkers(begin, end - 1);
   int clones_performed = 0;
 
   while(clones_performed < clone_count) {
-    int wid1 = get_random_walker_id();
-    int wid2 = get_random_walker_id();
+    int wid1 = dist_walkers(*generator);
+    int wid2 = dist_walkers(*generator);
 
     if(wid1 != wid2) {
       if(scores[wid1] > scores[wid2]) {
         // clone walker wid1 into wid2
-        walkers[wid2] = walkers[wid1];
+        walkers[wid2].clone_from(walkers[wid1]);
+        last_scores[wid2] = last_scores[wid1];
       } else {
         // the reverse
-        walkers[wid1] = walkers[wid2];
+        walkers[wid1].clone_from(walkers[wid2]);
+        last_scores[wid1] = last_scores[wid2];
       }
 
       ++ clones_performed;
     }
   }
-
-  return best;
 }
 
-ScoreOutput StochasticSearch::compute_score(int walker_id) {
-  connections_t const & walker = walkers[walker_id];
-
-  double score = 0;
-
-  // score having a wire connection from the input of the array
-  for(int input_id = 0; input_id < walker.size(); ++ input_id) {
-    if(walker[input_id] == ARRAY_INPUT_ID) {
-      score += params.input_recovered_factor;
-      break;
-    }
-  }
+ScoreOutput StochasticSearch::perform_pipelined_cycles(double iter_fraction, int cycle_count, int clone_count,
+                                                       const NoiseParams &noise_cfg) {
+  int walker_count = walkers.size();
+  int batch_count = pipeline_batch_count;
 
-  // score number of units that have both inputs connected
-  int count_one_input_connected = 0;
-  int count_both_inputs_connected = 0;
-  for(int input_id = 0; input_id < walker.size(); input_id += 2) {
-    if(walker[input_id] != -1) {
-      if(walker[input_id + 1] != -1) {
-        ++ count_both_inputs_connected;
-      } else {
-        ++ count_one_input_connected;
-      }
-    }
-  }
-  if(count_both_inputs_connected > 0) {
-    score += 1.0 + count_both_inputs_connected * params.unit_both_inputs_factor;
+  // batch b holds the walkers in [batch_bounds[b], batch_bounds[b + 1])
+  vector<int> batch_bounds(batch_count + 1);
+  for(int batch_id = 0; batch_id <= batch_count; ++ batch_id) {
+    batch_bounds[batch_id] = (long) walker_count * batch_id / batch_count;
   }
 
-  // score distance between unit outputs and function terms
-  auto unit_outputs = compute_unit_outputs(walker);
+  int inputs_to_change = count_inputs_to_change(iter_fraction, noise_cfg);
+  bernoulli_distribution mutate_in_pass(1.0 / cycle_count);
 
-  vector<double> distances;
-  distances.reserve(unit_outputs.size());
+  vector<ScoreOutput> score_outs(walker_count);
+  vector<double> scores(walker_count, numeric_limits<double>::lowest());
+  ScoreOutput best{0, numeric_limits<double>::lowest()};
 
-  for(int uid = 0; uid < unit_outputs.size(); ++ uid) {
-    auto & uo = unit_outputs[uid];
-    if(uo.has_output && uo.is_valid) {
-      distances.push_back(compute_poly_distance(poly, uo.poly));
-    }
+  // stages work on distinct batches, so they update distinct last scores
+  if(last_scores.empty()) {
+    last_scores.assign(walker_count, numeric_limits<double>::quiet_NaN());
   }
 
-  // take the top 3 closes distances and add them to the score
-  sort(distances.begin(), distances.end());
-
-  for(int did = 0; did < 3 && did < distances.size(); ++ did) {
-    // we actually want the opposite of the distance
-    // take exp(-distance) because we want this to be symetrically "spikey"
-    score += exp(-1.0 * distances[did]) * params.distance_factor;
-  }
+  // 0 for walkers left alone in this pass
+  vector<unsigned> walker_seeds(walker_count, 0);
+
+  int pass_count = cycle_count * batch_count;
+  for(int step = 0; step < pass_count + 2; ++ step) {
+    // the batches in each stage, passes out of range leave their stage idle
+    int mutate_begin = 0, mutate_end = 0;
+    int score_begin = 0, score_end = 0;
+    int select_begin = 0, select_end = 0;
+    if(step < pass_count) {
+      mutate_begin = batch_bounds[step % batch_count];
+      mutate_end = batch_bounds[step % batch_count + 1];
+    }
+    if(step >= 1 && step - 1 < pass_count) {
+      score_begin = batch_bounds[(step - 1) % batch_count];
+      score_end = batch_bounds[(step - 1) % batch_count + 1];
+    }
+    if(step >= 2) {
+      select_begin = batch_bounds[(step - 2) % batch_count];
+      select_end = batch_bounds[(step - 2) % batch_count + 1];
+    }
 
-  // score all terms that were successfully recovered (still useful in light of the above ?)
+    // random numbers are drawn in order here, stages use their own engines
+    for(int wid = mutate_begin; wid < mutate_end; ++ wid) {
+      walker_seeds[wid] = mutate_in_pass(random_generator) ? max(1u, (unsigned) random_generator()) : 0;
+    }
+    unsigned select_seed = random_generator();
+    int select_clone_count = ((long) clone_count * (select_end - select_begin) + walker_count / 2) / walker_count;
+
+    // task 0 selects, then one task per walker to score and one per walker to mutate
+    int score_count = score_end - score_begin;
+    int mutate_count = mutate_end - mutate_begin;
+    run_parallel(1 + score_count + mutate_count, PIPELINE_CHUNK_SIZE, [&](int task_id, PropagationStats * stats) {
+      if(task_id == 0) {
+        mt19937 select_generator(select_seed);
+        select_walkers(select_begin, select_end, select_clone_count, scores, & select_generator);
+      } else if(task_id <= score_count) {
+        int wid = score_begin + task_id - 1;
+        score_outs[wid] = compute_score(wid, stats);
+        scores[wid] = score_outs[wid].best_score;
+        last_scores[wid] = scores[wid];
+      } else {
+        int wid = mutate_begin + task_id - 1 - score_count;
+        if(walker_seeds[wid] != 0) {
+          mt19937 walker_generator(walker_seeds[wid]);
+          mutate_walker(& walkers[wid], inputs_to_change, noise_cfg, & walker_generator, stats);
+        }
+      }
+    });
 
-  // extra score if the whole function is recovered by a unit output
-  int times_recovered = 0;
-  for(int uid = 0; uid < unit_outputs.size(); ++ uid) {
-    auto & uo = unit_outputs[uid];
-    if(uo.poly == poly) {
-      ++ times_recovered;
+    for(int wid = score_begin; wid < score_end; ++ wid) {
+      if(best.best_score < score_outs[wid].best_score) {
+        best = score_outs[wid];
+      }
     }
   }
-  if(times_recovered > 0) {
-    score += params.function_recovered_factor;
-  }
-
-  // score speed prior i.e. all wire lengths
-  double wire_lengths = compute_wire_lengths(walker);
-  score += params.speed_prior_factor * 1.0 / (1.0 + wire_lengths);
 
-  return {times_recovered, score};
+  return best;
 }
 
-unit_outputs_t StochasticSearch::compute_unit_outputs(connections_t const & conns) {
-  unit_outputs_t unit_outputs(CONN_UNIT_COUNT, {false, false, {}});
-
-  /* Do a forward traversal starting from the array input and propagate its
-   * signal to all connections. Then do the same for all units that have both
-   * inputs connected.
-   */
+std::vector<double> const & StochasticSearch::known_scores() {
+  if(last_scores.empty()) {
+    last_scores.assign(walkers.size(), numeric_limits<double>::quiet_NaN());
+  }
 
-  // first construct a reverse mapping from unit_id to list of units it is connected to
-  vector<vector<int>> outgoing_conns =
-    compute_output_mapping_from_connections(conns);
-
-  // now do the propagation, starting from the input of the array because
-  // it always outputs the polynomial "x"
-  deque<int> propagation_front;
-  propagation_front.push_back(ARRAY_INPUT_ID);
-  unit_outputs[ARRAY_INPUT_ID].has_output = true;
-  unit_outputs[ARRAY_INPUT_ID].is_valid = true;
-  unit_outputs[ARRAY_INPUT_ID].poly = {1};
-
-  while(! propagation_front.empty()) {
-    int unit_id = propagation_front.front();
-    propagation_front.pop_front();
-
-    // compute output of current unit
-    if(unit_id != ARRAY_INPUT_ID) {
-      int in_unit_id1 = conns[unit_id * 2];
-      int in_unit_id2 = conns[unit_id * 2 + 1];
-      int unit_type = unit_id % 3;
-      unit_outputs[unit_id] = compute_one_unit_output(
-        unit_type,
-        unit_outputs[in_unit_id1],
-        unit_outputs[in_unit_id2]
-      );
+  vector<int> unscored_ids;
+  for(int wid = 0; wid < walkers.size(); ++ wid) {
+    if(std::isnan(last_scores[wid])) {
+      unscored_ids.push_back(wid);
     }
+  }
+  run_parallel(unscored_ids.size(), SCORE_CHUNK_SIZE, [&](int index, PropagationStats * stats) {
+    int wid = unscored_ids[index];
+    last_scores[wid] = compute_score(wid, stats).best_score;
+  });
+  return last_scores;
+}
 
-    // propagate to its downstream units
-    for(int downstream_unit_id : outgoing_conns[unit_id]) {
-      // check if both inputs are connected and add it to the list to be processed
-      int down_unit_in_id1 = conns[downstream_unit_id * 2];
-      int down_unit_in_id2 = conns[downstream_unit_id * 2 + 1];
+ScoreOutput StochasticSearch::compute_score(int walker_id, PropagationStats * stats) {
+  Walker & walker = walkers[walker_id];
 
-      // sanity check
-      if(down_unit_in_id1 != unit_id && down_unit_in_id2 != unit_id) {
-        cerr << "ERROR: propagation graph structure is broken for unit " << unit_id << endl;
-      }
+  int wire_lengths = 0;
+  ScoreOutput score = score_walker(& walker, plan, params, limits, stats, & wire_lengths);
 
-      if(down_unit_in_id1 != -1 && down_unit_in_id2 != -1) {
-        // both inputs connected
-        // make sure both inputs have signal flowing through
-        if(unit_outputs[down_unit_in_id1].has_output &&
-           unit_outputs[down_unit_in_id2].has_output) {
-          propagation_front.push_back(downstream_unit_id);
-        }
-      }
+  /* With the prefilter enabled, a recovery found in the symbolic outputs is
+   * confirmed numerically: a unit equal to the target always matches its
+   * fingerprint. Recoveries are rare, so the fingerprints are only computed
+   * for the walkers that claim one, and the distance is kept for everyone.
+   */
+  if(use_fingerprint_prefilter && score.times_function_recovered > 0) {
+    vector<int> const & order = walker.propagation_order();
+    if(! has_matching_unit(compute_unit_fingerprints(walker.connection_array(), order, geometry),
+                           order, target_fingerprint)) {
+      score.times_function_recovered = 0;
+      score.best_score -= params.function_recovered_factor;
     }
+  }
 
+  // keep the circuit around in case it is among the best, before a clone overwrites it
+  if(best_tracker->would_accept(score.best_score)) {
+    best_tracker->offer({score.best_score, walker.connections(), wire_lengths,
+                         score.times_function_recovered > 0});
   }
 
-  return unit_outputs;
+  return score;
 }
 
 /* Inject some noise into all the random walkers.
@@ -246,6 +681,21 @@ unit_outputs_t StochasticSearch::compute_unit_outputs(connections_t const & conn
  * - only connect to units that have a valid output
  */
 void StochasticSearch::inject_noise(double iter_fraction, const NoiseParams &noise_cfg) {
+  int inputs_to_change = count_inputs_to_change(iter_fraction, noise_cfg);
+
+  // one seed per walker, drawn in order from the main random engine
+  vector<unsigned> walker_seeds(walkers.size());
+  for(auto & seed : walker_seeds) {
+    seed = random_generator();
+  }
+
+  run_parallel(walkers.size(), NOISE_CHUNK_SIZE, [&](int wid, PropagationStats * stats) {
+    mt19937 walker_generator(walker_seeds[wid]);
+    mutate_walker(& walkers[wid], inputs_to_change, noise_cfg, & walker_generator, stats);
+  });
+}
+
+int StochasticSearch::count_inputs_to_change(double iter_fraction, const NoiseParams &noise_cfg) const {
   double fraction_to_change =
       noise_cfg.starting_inputs_change_fraction *
 
@@ -254,65 +704,36 @@ void StochasticSearch::inject_noise(double iter_fraction, const NoiseParams &noi
 
   // cap the minimum to make sure we always change at least a few inputs
   fraction_to_change = max(fraction_to_change, noise_cfg.min_inputs_change_fraction);
-  int inputs_to_change = CONN_INPUT_COUNT * fraction_to_change;
+  return geometry.conn_input_count() * fraction_to_change;
+}
 
+void StochasticSearch::mutate_walker(Walker *walker, int inputs_to_change, const NoiseParams &noise_cfg,
+                                     std::mt19937 *walker_generator, PropagationStats *stats) {
+  uniform_int_distribution<int> dist_walker_inputs(dist_inputs.param());
   bernoulli_distribution change_valid_input(noise_cfg.probability_change_valid_input);
 
-  for(auto & walker : walkers) {
-    auto unit_outputs = compute_unit_outputs(walker);
-
-    // compute units with valid outputs
-    vector<int> units_with_valid_outputs;
-    for(int unit_id = 0; unit_id < unit_outputs.size(); ++ unit_id) {
-      if(unit_outputs[unit_id].is_valid) {
-        units_with_valid_outputs.push_back(unit_id);
-      }
-    }
+  for(int cid = 0; cid < inputs_to_change; ++ cid) {
+    int input_id = dist_walker_inputs(*walker_generator);
+    int upstream_unit_id = walker->input(input_id);
 
-    for(int cid = 0; cid < inputs_to_change; ++ cid) {
-      int input_id = get_random_input_id();
-      int upstream_unit_id = walker[input_id];
+    // units with valid outputs, updated with the effects of the previous rewires
+    auto & units_with_valid_outputs = walker->valid_units(limits, stats);
 
-      if(upstream_unit_id >= 0 && unit_outputs[upstream_unit_id].is_valid) {
-        // input is connected to a wire producing a valid signal
-        // sample the config Bernoulli distribution to see if we should change it
-        if(change_valid_input(random_generator)) {
-          try_connect(& walker, input_id, units_with_valid_outputs, noise_cfg.retries_on_cycle);
-        }
-      } else {
-        try_connect(& walker, input_id, units_with_valid_outputs, noise_cfg.retries_on_cycle);
-        // TODO: could look into updating the units_with_valid_outputs on the fly here
+    if(upstream_unit_id >= 0 && units_with_valid_outputs.contains(upstream_unit_id)) {
+      // input is connected to a wire producing a valid signal
+      // sample the config Bernoulli distribution to see if we should change it
+      if(change_valid_input(*walker_generator)) {
+        try_connect(walker, input_id, walker_generator, stats);
       }
+    } else {
+      try_connect(walker, input_id, walker_generator, stats);
     }
   }
 }
 
-void StochasticSearch::try_connect(connections_t * conns, int input_id, const std::vector<int> &unit_ids, int retries_on_cycle) {
-  assert(unit_ids.size() > 0);
-
-  uniform_int_distribution<int> dist_units(0, unit_ids.size() - 1);
-  int tries = 0;
-  bool have_connected = false;
-  int unit_id = input_id / 2;
-
-  do {
-    int sampled_index = dist_units(random_generator);
-    int target_unit_id = unit_ids[sampled_index];
-
-    // connect only if this would not introduce a cycle
-    if(! has_upstream_conn(*conns, target_unit_id, unit_id)) {
-      conns->at(input_id) = target_unit_id;
-      have_connected = true;
-    }
-
-    ++ tries;
-  } while(tries < retries_on_cycle && ! have_connected);
-}
-
-int StochasticSearch::get_random_walker_id() {
-  return dist_walkers(random_generator);
-}
-
-int StochasticSearch::get_random_input_id() {
-  return dist_inputs(random_generator);
+void StochasticSearch::try_connect(Walker * walker, int input_id, std::mt19937 * walker_generator,
+                                   PropagationStats * stats) {
+  // only sample units that would not introduce a cycle, the input of the array
+  // can always be connected
+  walker->rewire(input_id, walker->sample_connectable_unit(input_id / 2, limits, stats, walker_generator));
 }
@@ -3,6 +3,17 @@
 
 #include "definitions.h"
 #include "scoring.h"
+#include "propagation.h"
+#include "fingerprint.h"
+#include "walker.h"
+#include "best_tracker.h"
+#include "checkpoint_writer.h"
+#include "population_file.h"
+#include "solution_database.h"
+#include "poly_table.h"
+#include "utils/work_stealing_pool.h"
+#include <functional>
+#include <memory>
 #include <vector>
 #include <random>
 
@@ -11,18 +22,14 @@ struct NoiseParams {
   double inputs_change_decay;
   double min_inputs_change_fraction;
   double probability_change_valid_input;
-  int retries_on_cycle;
-};
-
-struct ScoreOutput {
-  int times_function_recovered;
-  double best_score;
 };
 
 class StochasticSearch {
+  // size and column types of the physical array
+  Geometry geometry;
+
   // random engine
   std::mt19937 random_generator;
-  std::uniform_int_distribution<int> dist_walkers;
   std::uniform_int_distribution<int> dist_inputs;
 
   // hyperparameters for the scoring function i.e. tradeoffs between the
@@ -32,32 +39,221 @@ class StochasticSearch {
   // polynomial function to recover
   std::vector<int> poly;
 
+  // precomputed tables for scoring unit outputs against poly
+  scoring::ScoringPlan plan;
+
+  // caps on the size of unit outputs and how often they were hit
+  propagation::PropagationLimits limits;
+  propagation::PropagationStats limit_stats;
+
+  // numeric evaluation of poly, used to confirm recoveries
+  fingerprint::fingerprint_t target_fingerprint;
+  bool use_fingerprint_prefilter;
+
   // the population of walkers
-  std::vector<connections_t> walkers;
+  std::vector<Walker> walkers;
+
+  /* Score of each walker when it was last scored, carried along when it is
+   * cloned, NaN if it never was e.g. a migrant that just came in. Walkers
+   * changed by noise since keep their last score until the next cycle.
+   * Empty when the whole population is new.
+   */
+  std::vector<double> last_scores;
+
+  // the best circuits scored so far, possibly shared with other searches
+  std::shared_ptr<BestTracker> best_tracker;
+
+  // whether train prints a summary of each iteration
+  bool verbose;
+
+  // threads scoring and mutating walkers, none to do it all on the calling thread
+  std::unique_ptr<utils::work_stealing_pool> pool;
+
+  // number of batches in pipelined mode, 0 if disabled
+  int pipeline_batch_count;
+
+  // where and every how many iterations train writes checkpoints, if it does
+  std::string checkpoint_path;
+  int checkpoint_interval;
+  std::unique_ptr<CheckpointWriter> checkpoint_writer;
+
+  // where the next call to train starts after a resume, for that many iterations
+  int resume_iteration;
+  int resume_iteration_count;
+
+  void write_checkpoint(int next_iteration, int iteration_count);
+
+  // mapped copy of the walkers, synced every population_sync_interval iterations
+  std::unique_ptr<PopulationFile> population_file;
+  int population_sync_interval;
+
+  void store_population(int iteration, int iteration_count);
+
+  // circuits known for the target from earlier runs, and where the new ones go
+  std::shared_ptr<SolutionDatabase> solution_database;
+  std::shared_ptr<const PolyTable> poly_table;
+
+  void seed_from_solutions();
+  void record_solutions();
+
+  // call body(index, stats) for all indices in [0, count), in parallel if
+  // there is a pool, and add the stats of all threads to limit_stats
+  void run_parallel(int count, int chunk_size, std::function<void(int, propagation::PropagationStats *)> const & body);
 
   void initialize_walkers(int walker_count);
-  ScoreOutput perform_cycle(int iteration_id, int cycle_id, int clone_count);
+  ScoreOutput perform_cycle(int clone_count);
 
-  /* Implements the scoring metric that we use to drive the stochastic search.
+  /* All cycles and the noise of one iteration in pipelined mode.
    *
+   * The population is split into batches that go through three stages:
+   * mutation, scoring and selection, i.e. cloning within the batch. At each
+   * step one batch is mutated while the previous one is scored and the one
+   * before is selected, all as tasks of the same parallel loop. A pass of all
+   * batches makes up a cycle. Walkers are mutated with probability
+   * 1 / cycle_count at each pass, to get on average the noise of one
+   * inject_noise per iteration.
    */
-  ScoreOutput compute_score(int walker_id);
+  ScoreOutput perform_pipelined_cycles(double iter_fraction, int cycle_count, int clone_count,
+                                       NoiseParams const & noise_cfg);
+
+  // clone_count tournaments between random walkers in [begin, end), the
+  // walker with the lower score becomes a clone of the other and takes its
+  // last score
+  void select_walkers(int begin, int end, int clone_count, std::vector<double> const & scores,
+                      std::mt19937 * generator);
 
-  /* Implement graph traversal to compute what outputs each unit generates.
+  /* Implements the scoring metric that we use to drive the stochastic search.
+   *
    */
-  unit_outputs_t compute_unit_outputs(const connections_t &conns);
+  ScoreOutput compute_score(int walker_id, propagation::PropagationStats * stats);
 
-  // injects random noise into walkers, disallowing cycles
-  void inject_noise(double iter_fraction, NoiseParams const & noise_cfg);
-  void try_connect(connections_t * cconns, int input_id, std::vector<int> const & unit_ids, int retries_on_cycle);
+  // the last scores of all walkers, scoring first those that have none
+  std::vector<double> const & known_scores();
 
-  // utility functions for random sampling
-  int get_random_walker_id();
-  int get_random_input_id();
+  /* Injects random noise into walkers, disallowing cycles. Each walker gets
+   * its own random engine, seeded in order from the main one, so the result
+   * does not depend on the number of threads.
+   */
+  void inject_noise(double iter_fraction, NoiseParams const & noise_cfg);
+  int count_inputs_to_change(double iter_fraction, NoiseParams const & noise_cfg) const;
+  void mutate_walker(Walker * walker, int inputs_to_change, NoiseParams const & noise_cfg,
+                     std::mt19937 * walker_generator, propagation::PropagationStats * stats);
+  void try_connect(Walker * walker, int input_id, std::mt19937 * walker_generator,
+                   propagation::PropagationStats * stats);
 
 public:
-  StochasticSearch(std::vector<int> const & polynomial, int walker_count, scoring::ScoringParams params);
+  StochasticSearch(std::vector<int> const & polynomial, int walker_count, scoring::ScoringParams params,
+                   Geometry const & geometry = default_geometry());
   void train(int iteration_count, int cycle_count, int clone_count, const NoiseParams &noise);
+
+  /* One iteration of train: cycle_count cycles of scoring and cloning, then
+   * noise according to how far iter_id is into the iteration_count iterations.
+   * Returns the best score over the cycles.
+   */
+  ScoreOutput train_iteration(int iter_id, int iteration_count, int cycle_count, int clone_count,
+                              NoiseParams const & noise);
+
+  // reseed the random engine, for reproducible runs
+  void set_seed(unsigned seed);
+
+  void set_verbose(bool enabled);
+
+  /* Score and inject noise into walkers on this many threads, which steal work
+   * from each other. With more than one, train ends with a report of the time
+   * each thread spent busy and idle.
+   */
+  void set_thread_count(int thread_count);
+
+  /* Overlap mutation, scoring and selection by running them on different
+   * batches of the population at the same time, see perform_pipelined_cycles.
+   * Selection happens within batches only. At least 3 batches are used, 0
+   * goes back to the default mode.
+   */
+  void set_pipeline_batch_count(int batch_count);
+
+  /* Write a checkpoint to path every interval iterations of train, on a
+   * background thread, see serialization::SearchCheckpoint. An empty path
+   * stops checkpointing.
+   */
+  void set_checkpoint(std::string const & path, int interval);
+
+  // wait until checkpoints are written
+  void flush_checkpoints();
+
+  /* Restore the walkers, random engine and best circuits from a checkpoint.
+   * The next call to train with the same iteration count then continues the
+   * interrupted one, exactly as if it had not stopped. False if the
+   * checkpoint cannot be read or does not fit this search.
+   */
+  bool resume(std::string const & path);
+
+  /* Keep a copy of the walkers in a memory mapped file at path, updated and
+   * synced to disk every sync_interval iterations of train and after the
+   * last one. If the file holds a population of the same size and geometry,
+   * the walkers are loaded from it first and the next call to train with the
+   * same iteration count goes on from the stored iteration, with the noise it
+   * would have had but a new random sequence. False if the file holds another
+   * population. An empty path stops using the file.
+   *
+   * The walkers being trained stay on the heap with their caches, the file
+   * is a durable copy of their connections and does not reduce the memory a
+   * population needs.
+   */
+  bool set_population_file(std::string const & path, int sync_interval);
+
+  /* Start train from the circuits the database knows for the target, in
+   * place of the worst walkers, and record the best circuits found in it
+   * at the end.
+   */
+  void set_solution_database(std::shared_ptr<SolutionDatabase> database);
+
+  /* Start over from walkers built out of known subcircuits instead of empty
+   * ones: each walker gets a recipe for every term of the target, at random
+   * rows, taken from the solution database if set or built in otherwise,
+   * see recipes::make_recipe_library. The search then only has to combine
+   * the terms.
+   */
+  void warm_start();
+
+  /* Also start train from the construction of the target in the table, when
+   * the target is small enough to be in it.
+   */
+  void set_poly_table(std::shared_ptr<const PolyTable> table);
+
+  void set_propagation_limits(propagation::PropagationLimits const & new_limits);
+
+  /* Confirm numerically that walkers recovering the target symbolically have
+   * a unit matching it at the sample points. Every walker is still evaluated
+   * symbolically for the distance part of its score.
+   */
+  void set_fingerprint_prefilter(bool enabled);
+
+  // the best circuits scored so far, can be read from any thread at any time
+  std::shared_ptr<BestTracker> best_circuits() const { return best_tracker; }
+
+  // track the best circuits in the given tracker e.g. one shared between islands
+  void set_best_tracker(std::shared_ptr<BestTracker> tracker);
+
+  /* Exchange of walkers with other searches over the same geometry. Walkers
+   * are ranked by their scores as of the last cycle, so that migration does
+   * not rescore the whole population.
+   */
+
+  // copies of the count walkers with the highest scores, best first, and
+  // optionally their scores
+  void get_best_walkers(int count, std::vector<Walker> * best, std::vector<double> * best_scores = nullptr);
+
+  // replace the walkers with the lowest scores by copies of the given ones,
+  // ignoring those for another geometry
+  void replace_worst_walkers(std::vector<Walker> const & replacements);
+
+  // ids of the count walkers with the highest scores, best first, and their scores
+  void get_best_walker_ids(int count, std::vector<int> * best_ids, std::vector<double> * best_scores);
+
+  Walker const & walker(int walker_id) const { return walkers[walker_id]; }
+
+  // replace one walker by a copy of the given one e.g. to swap walkers between searches
+  void replace_walker(int walker_id, Walker const & replacement);
 };
 
 #endif // STOCHASTICSEARCH_H
@@ -0,0 +1,134 @@
+#ifndef COW_ARRAY_H
+#define COW_ARRAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+/* Reference counted handle to a value shared between copies of the handle,
+ * copied on the first write through a handle that is not the only one.
+ *
+ * Unlike std::shared_ptr::use_count(), the uniqueness check synchronizes with
+ * the release of the other handles, so handles sharing a value can be used
+ * and dropped on different threads, as long as each handle is only used by
+ * one thread at a time.
+ */
+template<typename V>
+class cow_ref {
+  struct holder {
+    std::atomic<long> ref_count;
+    V value;
+
+    holder(V && value) : ref_count(1), value(std::move(value)) {}
+  };
+
+  holder * shared;
+
+  void release() {
+    if(shared != nullptr && shared->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete shared;
+    }
+  }
+
+public:
+  cow_ref(V value = V()) : shared(new holder(std::move(value))) {}
+
+  cow_ref(cow_ref const & other) : shared(other.shared) {
+    if(shared != nullptr) {
+      shared->ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  cow_ref(cow_ref && other) : shared(other.shared) {
+    other.shared = nullptr;
+  }
+
+  cow_ref & operator=(cow_ref other) {
+    std::swap(shared, other.shared);
+    return *this;
+  }
+
+  ~cow_ref() { release(); }
+
+  V const & operator*() const { return shared->value; }
+  V const * operator->() const { return & shared->value; }
+
+  // the value, copied first if it is shared with other handles
+  V & mutable_value() {
+    if(shared->ref_count.load(std::memory_order_acquire) != 1) {
+      *this = cow_ref(V(shared->value));
+    }
+    return shared->value;
+  }
+};
+
+/* Fixed size array stored as chunks shared between copies, copy-on-write.
+ *
+ * Copying an array only shares its table of chunks, so it is O(1). The first
+ * write to a shared table copies the table, i.e. one pointer per chunk, and
+ * the first write to a shared chunk copies that chunk alone. Chunks default to
+ * 64 bytes.
+ *
+ * Copies can live on different threads as long as each one is only used by
+ * one thread at a time.
+ */
+template<typename T>
+class cow_array {
+  typedef std::vector<T> chunk_t;
+  typedef std::vector<cow_ref<chunk_t>> table_t;
+
+  int length;
+  int chunk_length;
+  cow_ref<table_t> table;
+
+  chunk_t & mutable_chunk(int chunk_id) {
+    return table.mutable_value()[chunk_id].mutable_value();
+  }
+
+public:
+  cow_array(int size = 0, T const & value = T(), int chunk_size = std::max<int>(1, 64 / sizeof(T)))
+    : length(size),
+      chunk_length(chunk_size) {
+    fill(value);
+  }
+
+  int size() const { return length; }
+
+  int chunk_size() const { return chunk_length; }
+
+  T const & operator[](int index) const {
+    return (*(*table)[index / chunk_length])[index % chunk_length];
+  }
+
+  void set(int index, T const & value) {
+    mutable_chunk(index / chunk_length)[index % chunk_length] = value;
+  }
+
+  // the elements of one chunk, which are contiguous
+  T const * chunk_data(int chunk_id) const { return (*table)[chunk_id]->data(); }
+
+  T * mutable_chunk_data(int chunk_id) { return mutable_chunk(chunk_id).data(); }
+
+  // set all elements, which then share a single chunk until written to
+  void fill(T const & value) {
+    cow_ref<chunk_t> chunk(chunk_t(chunk_length, value));
+    table = cow_ref<table_t>(table_t((length + chunk_length - 1) / chunk_length, chunk));
+  }
+
+  // copy all elements into a plain vector
+  void copy_to(std::vector<T> * values) const {
+    values->resize(length);
+    for(int index = 0; index < length; index += chunk_length) {
+      int count = std::min(chunk_length, length - index);
+      std::copy(chunk_data(index / chunk_length), chunk_data(index / chunk_length) + count,
+                values->begin() + index);
+    }
+  }
+};
+
+}
+
+#endif // COW_ARRAY_H
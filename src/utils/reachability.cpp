@@ -0,0 +1,118 @@
+#include "reachability.h"
+
+#include <algorithm>
+
+using namespace std;
+
+utils::reachability::reachability(int node_count)
+  : node_count(node_count),
+    word_count((node_count + 63) / 64),
+    rows(node_count * word_count, 0, word_count),
+    reached(word_count, 0) {
+}
+
+void utils::reachability::add_edge(int from, int to) {
+  // everything that reaches the source now reaches the target and its descendants
+  copy(row(to), row(to) + word_count, reached.begin());
+  reached[to / 64] |= uint64_t(1) << (to % 64);
+
+  for(int node = 0; node < node_count; ++ node) {
+    if(node != from && ! reaches(node, from)) {
+      continue;
+    }
+
+    // rows that already have all of them are left shared
+    const uint64_t * node_row = row(node);
+    bool missing = false;
+    for(int wid = 0; wid < word_count; ++ wid) {
+      missing = missing || (reached[wid] & ~ node_row[wid]) != 0;
+    }
+
+    if(missing) {
+      uint64_t * new_node_row = mutable_row(node);
+      for(int wid = 0; wid < word_count; ++ wid) {
+        new_node_row[wid] |= reached[wid];
+      }
+    }
+  }
+}
+
+void utils::reachability::remove_edge(int from, int to, std::vector<std::vector<int>> const & successors) {
+  auto & from_successors = successors[from];
+  if(find(from_successors.begin(), from_successors.end(), to) != from_successors.end()) {
+    // a parallel edge is left, nothing changes
+    return;
+  }
+
+  // only the source and its upstream nodes can lose descendants
+  affected.clear();
+  bool has_cycle = false;
+  for(int node = 0; node < node_count; ++ node) {
+    if(node == from || reaches(node, from)) {
+      int descendant_count = 0;
+      for(int wid = 0; wid < word_count; ++ wid) {
+        descendant_count += __builtin_popcountll(row(node)[wid]);
+      }
+      affected.push_back({descendant_count, node});
+      has_cycle = has_cycle || reaches(node, node);
+    }
+  }
+
+  /* Without cycles, a node has strictly more descendants than any of its
+   * descendants, so recomputing by increasing count only reads rows that are
+   * already up to date and a single pass is enough. Cycles need more passes
+   * from empty rows, until nothing changes.
+   */
+  sort(affected.begin(), affected.end());
+  if(has_cycle) {
+    for(auto & entry : affected) {
+      uint64_t * node_row = mutable_row(entry.second);
+      fill(node_row, node_row + word_count, 0);
+    }
+  }
+
+  bool changed = true;
+  while(changed) {
+    changed = false;
+
+    for(auto & entry : affected) {
+      int node = entry.second;
+      fill(reached.begin(), reached.end(), 0);
+
+      for(int successor : successors[node]) {
+        const uint64_t * successor_row = row(successor);
+        for(int wid = 0; wid < word_count; ++ wid) {
+          reached[wid] |= successor_row[wid];
+        }
+        reached[successor / 64] |= uint64_t(1) << (successor % 64);
+      }
+
+      // rows that stay the same are left shared
+      if(! equal(reached.begin(), reached.end(), row(node))) {
+        copy(reached.begin(), reached.end(), mutable_row(node));
+        changed = has_cycle;
+      }
+    }
+  }
+}
+
+void utils::reachability::clear() {
+  rows.fill(0);
+}
+
+bool utils::reachability::reaches(int from, int to) const {
+  return (row(from)[to / 64] >> (to % 64)) & 1;
+}
+
+void utils::reachability::descendants(int node, std::vector<int> *nodes) const {
+  nodes->clear();
+
+  const uint64_t * node_row = row(node);
+  for(int wid = 0; wid < word_count; ++ wid) {
+    uint64_t word = node_row[wid];
+    while(word != 0) {
+      nodes->push_back(wid * 64 + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <cstdint>
+#include <vector>
+#include "cow_array.h"
+
+namespace utils {
+
+/* Transitive closure of a directed graph on nodes [0, node_count), kept up
+ * to date as edges are added and removed.
+ *
+ * Each node has a row of bits, one per node it can reach through at least
+ * one edge. Adding an edge ORs the row of its target into the rows of its
+ * source and of everything upstream of it. Removing an edge recomputes the
+ * rows of the source and of its upstream nodes from their successors.
+ * Reachability queries are then a single bit test.
+ *
+ * The graph itself is owned by the caller, which usually has it at hand
+ * already, and is only needed on removal.
+ *
+ * Rows are stored copy-on-write, so copies of a closure are cheap and only
+ * copy the rows they change.
+ */
+class reachability {
+  int node_count;
+  int word_count;
+
+  // rows of the closure, one chunk of word_count words each
+  cow_array<uint64_t> rows;
+
+  // scratch space for updates, to avoid allocations
+  std::vector<uint64_t> reached;
+  std::vector<std::pair<int, int>> affected;
+
+  uint64_t * mutable_row(int node) { return rows.mutable_chunk_data(node); }
+
+public:
+  reachability(int node_count = 0);
+
+  void add_edge(int from, int to);
+
+  // successors lists the successors of each node once the edge is removed,
+  // any parallel edge left between the two nodes included
+  void remove_edge(int from, int to, std::vector<std::vector<int>> const & successors);
+
+  // remove all edges
+  void clear();
+
+  bool reaches(int from, int to) const;
+
+  // the bits of the nodes reachable from the given node
+  uint64_t const * row(int node) const { return rows.chunk_data(node); }
+
+  int words_per_row() const { return word_count; }
+
+  // the nodes reachable from the given node, in increasing order
+  void descendants(int node, std::vector<int> * nodes) const;
+};
+
+}
+
+#endif // REACHABILITY_H
@@ -0,0 +1,54 @@
+#include "sparse_set.h"
+
+#include <algorithm>
+
+utils::sparse_set::sparse_set(int capacity, bool ordered)
+  : index(capacity, -1),
+    ordered(ordered) {
+}
+
+bool utils::sparse_set::contains(int value) const {
+  return index[value] != -1;
+}
+
+void utils::sparse_set::insert(int value) {
+  if(index[value] != -1) {
+    return;
+  }
+
+  int position = dense.size();
+  if(ordered) {
+    position = std::lower_bound(dense.begin(), dense.end(), value) - dense.begin();
+    for(int moved = position; moved < dense.size(); ++ moved) {
+      ++ index[dense[moved]];
+    }
+  }
+  index[value] = position;
+  dense.insert(dense.begin() + position, value);
+}
+
+void utils::sparse_set::erase(int value) {
+  int position = index[value];
+  if(position != -1 && ordered) {
+    dense.erase(dense.begin() + position);
+    for(int moved = position; moved < dense.size(); ++ moved) {
+      -- index[dense[moved]];
+    }
+    index[value] = -1;
+  } else if(position != -1) {
+    // move the last member into the freed position
+    int last = dense.back();
+    dense[position] = last;
+    index[last] = position;
+
+    dense.pop_back();
+    index[value] = -1;
+  }
+}
+
+void utils::sparse_set::clear() {
+  for(int value : dense) {
+    index[value] = -1;
+  }
+  dense.clear();
+}
@@ -0,0 +1,48 @@
+#ifndef SPARSE_SET_H
+#define SPARSE_SET_H
+
+#include <vector>
+
+namespace utils {
+
+/* Set of integers in [0, capacity) from Briggs & Torczon.
+ * Insertion, removal, membership and access by position are all O(1), which
+ * also makes sampling a uniformly random member O(1).
+ * The order of the members changes on removal.
+ *
+ * An ordered set keeps its members in increasing order instead, so that
+ * their positions only depend on which values are in, not on the history of
+ * the set. Insertion and removal then take time linear in the size.
+ */
+class sparse_set {
+  // the members, packed
+  std::vector<int> dense;
+
+  // position of each value in dense, or -1 if it is not a member
+  std::vector<int> index;
+
+  bool ordered;
+
+public:
+  sparse_set(int capacity = 0, bool ordered = false);
+
+  bool contains(int value) const;
+
+  void insert(int value);
+
+  void erase(int value);
+
+  void clear();
+
+  int size() const { return dense.size(); }
+
+  bool empty() const { return dense.empty(); }
+
+  int at(int position) const { return dense[position]; }
+
+  std::vector<int> const & values() const { return dense; }
+};
+
+}
+
+#endif // SPARSE_SET_H
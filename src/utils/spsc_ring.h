@@ -0,0 +1,64 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <vector>
+
+namespace utils {
+
+/* Bounded lock-free queue between one producer thread and one consumer thread.
+ *
+ * Each side owns one index and only reads the other one, so neither push()
+ * nor pop() ever waits: they fail instead when the ring is full or empty.
+ * Values are moved in and out of preallocated slots.
+ */
+template<typename T>
+class spsc_ring {
+  std::vector<T> slots;
+
+  // next slot to read, written by the consumer only
+  std::atomic<size_t> head;
+
+  // next slot to write, written by the producer only
+  std::atomic<size_t> tail;
+
+public:
+  // holds up to capacity values
+  spsc_ring(int capacity)
+    : slots(capacity + 1),
+      head(0),
+      tail(0) {
+  }
+
+  spsc_ring(spsc_ring const &) = delete;
+  spsc_ring & operator=(spsc_ring const &) = delete;
+
+  // producer side, false if the ring is full
+  bool push(T && value) {
+    size_t current_tail = tail.load(std::memory_order_relaxed);
+    size_t next_tail = (current_tail + 1) % slots.size();
+    if(next_tail == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    slots[current_tail] = std::move(value);
+    tail.store(next_tail, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side, false if the ring is empty
+  bool pop(T * value) {
+    size_t current_head = head.load(std::memory_order_relaxed);
+    if(current_head == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    *value = std::move(slots[current_head]);
+    head.store((current_head + 1) % slots.size(), std::memory_order_release);
+    return true;
+  }
+};
+
+}
+
+#endif // SPSC_RING_H
@@ -0,0 +1,148 @@
+#include "work_stealing_pool.h"
+
+#include <chrono>
+
+using namespace std;
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+utils::work_stealing_pool::work_stealing_pool(int thread_count)
+  : thread_count(max(1, thread_count)),
+    loop_busy_seconds(this->thread_count, 0),
+    body(nullptr),
+    loop_id(0),
+    finished_workers(0),
+    stopping(false) {
+  for(int thread_id = 0; thread_id < this->thread_count; ++ thread_id) {
+    deques.emplace_back(new task_deque());
+  }
+  reset_statistics();
+
+  // thread 0 is the caller of parallel_for
+  for(int thread_id = 1; thread_id < this->thread_count; ++ thread_id) {
+    threads.emplace_back(&work_stealing_pool::worker_loop, this, thread_id);
+  }
+}
+
+utils::work_stealing_pool::~work_stealing_pool() {
+  {
+    lock_guard<mutex> guard(loop_lock);
+    stopping = true;
+  }
+  loop_started.notify_all();
+
+  for(auto & worker : threads) {
+    worker.join();
+  }
+}
+
+void utils::work_stealing_pool::reset_statistics() {
+  stats.assign(thread_count, {0, 0, 0, 0});
+}
+
+void utils::work_stealing_pool::worker_loop(int thread_id) {
+  long seen_loop_id = 0;
+  while(true) {
+    {
+      unique_lock<mutex> guard(loop_lock);
+      loop_started.wait(guard, [&]() { return stopping || loop_id != seen_loop_id; });
+      if(stopping) {
+        return;
+      }
+      seen_loop_id = loop_id;
+    }
+
+    run_tasks(thread_id);
+
+    {
+      lock_guard<mutex> guard(loop_lock);
+      ++ finished_workers;
+    }
+    loop_finished.notify_one();
+  }
+}
+
+bool utils::work_stealing_pool::take_task(int thread_id, task *next_task) {
+  // newest chunk of our own first, it is the most likely to still be in cache
+  {
+    auto & own = *deques[thread_id];
+    lock_guard<mutex> guard(own.lock);
+    if(! own.tasks.empty()) {
+      *next_task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // then the oldest chunk of another thread, starting with the next one
+  for(int offset = 1; offset < thread_count; ++ offset) {
+    auto & other = *deques[(thread_id + offset) % thread_count];
+    lock_guard<mutex> guard(other.lock);
+    if(! other.tasks.empty()) {
+      *next_task = other.tasks.front();
+      other.tasks.pop_front();
+      ++ stats[thread_id].steal_count;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void utils::work_stealing_pool::run_tasks(int thread_id) {
+  // no task is ever queued during a loop, so once all deques are empty we are done
+  task next_task;
+  while(take_task(thread_id, & next_task)) {
+    auto start = chrono::steady_clock::now();
+    (*body)(next_task.begin, next_task.end, thread_id);
+
+    loop_busy_seconds[thread_id] += seconds_since(start);
+    ++ stats[thread_id].task_count;
+  }
+}
+
+void utils::work_stealing_pool::parallel_for(int count, int chunk_size, std::function<void(int, int, int)> const &body) {
+  if(count <= 0) {
+    return;
+  }
+  chunk_size = max(1, chunk_size);
+
+  auto start = chrono::steady_clock::now();
+
+  // one contiguous range per thread, queued so that the owner starts from its front
+  for(int thread_id = 0; thread_id < thread_count; ++ thread_id) {
+    int range_begin = (long) count * thread_id / thread_count;
+    int range_end = (long) count * (thread_id + 1) / thread_count;
+
+    auto & own = *deques[thread_id];
+    lock_guard<mutex> guard(own.lock);
+    for(int begin = range_begin; begin < range_end; begin += chunk_size) {
+      own.tasks.push_front({begin, min(begin + chunk_size, range_end)});
+    }
+    loop_busy_seconds[thread_id] = 0;
+  }
+
+  {
+    lock_guard<mutex> guard(loop_lock);
+    this->body = & body;
+    finished_workers = 0;
+    ++ loop_id;
+  }
+  loop_started.notify_all();
+
+  run_tasks(0);
+
+  {
+    unique_lock<mutex> guard(loop_lock);
+    loop_finished.wait(guard, [&]() { return finished_workers == thread_count - 1; });
+    this->body = nullptr;
+  }
+
+  double loop_seconds = seconds_since(start);
+  for(int thread_id = 0; thread_id < thread_count; ++ thread_id) {
+    stats[thread_id].busy_seconds += loop_busy_seconds[thread_id];
+    stats[thread_id].idle_seconds += max(0.0, loop_seconds - loop_busy_seconds[thread_id]);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+struct worker_stats {
+  // time spent running tasks and waiting for others to finish theirs
+  double busy_seconds;
+  double idle_seconds;
+
+  long task_count;
+
+  // tasks taken from the deque of another thread
+  long steal_count;
+};
+
+/* Fixed set of threads running loops split into chunks, with work stealing.
+ *
+ * A loop over [0, count) is cut into one contiguous range per thread, and
+ * each range into chunks queued on the deque of its thread. Threads take
+ * chunks from the back of their own deque and, once it is empty, steal from
+ * the front of the others, so that threads with cheap chunks help those with
+ * expensive ones instead of idling.
+ *
+ * The thread calling parallel_for() takes part as thread 0.
+ */
+class work_stealing_pool {
+  struct task {
+    int begin;
+    int end;
+  };
+
+  struct task_deque {
+    std::mutex lock;
+    std::deque<task> tasks;
+  };
+
+  int thread_count;
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<task_deque>> deques;
+
+  std::vector<worker_stats> stats;
+
+  // time each thread spent on tasks during the current loop
+  std::vector<double> loop_busy_seconds;
+
+  // the current loop, workers wake up when loop_id changes
+  std::function<void(int, int, int)> const * body;
+  long loop_id;
+  int finished_workers;
+  bool stopping;
+  std::mutex loop_lock;
+  std::condition_variable loop_started;
+  std::condition_variable loop_finished;
+
+  void worker_loop(int thread_id);
+
+  void run_tasks(int thread_id);
+
+  bool take_task(int thread_id, task * next_task);
+
+public:
+  work_stealing_pool(int thread_count);
+  ~work_stealing_pool();
+
+  work_stealing_pool(work_stealing_pool const &) = delete;
+  work_stealing_pool & operator=(work_stealing_pool const &) = delete;
+
+  int size() const { return thread_count; }
+
+  /* Call body(begin, end, thread_id) on chunks of at most chunk_size indices
+   * covering [0, count), and return once all of them are done.
+   */
+  void parallel_for(int count, int chunk_size, std::function<void(int, int, int)> const & body);
+
+  std::vector<worker_stats> const & statistics() const { return stats; }
+
+  void reset_statistics();
+};
+
+}
+
+#endif // WORK_STEALING_POOL_H
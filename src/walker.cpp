@@ -0,0 +1,397 @@
+#include "walker.h"
+#include "scoring.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace propagation;
+using namespace scoring;
+
+// beyond this many changes a full rebuild of the caches is cheaper than a replay
+static const int MAX_JOURNAL_SIZE = 64;
+
+// random picks among the valid units before sampling falls back to a scan, for
+// units with most of the valid units downstream of them
+static const int CONNECT_ATTEMPTS = 8;
+
+// per unit scratch space for the traversals of update_outputs_downstream, all
+// zero in between them, on each thread so that clones need none of their own
+static thread_local vector<int> scratch;
+
+Walker::Walker(const Geometry &geometry)
+  : geom(make_shared<Geometry>(geometry)),
+    conns(geometry.conn_input_count(), -1),
+    wired(utils::sparse_set(geometry.unit_count())),
+    array_input_id(geometry.array_input_id()),
+    array_input_conn_count(0),
+    one_input_count(0),
+    both_inputs_count(0),
+    closure(geometry.conn_unit_count()),
+    first_revision(0),
+    outgoing_revision(-1),
+    order_revision(-1),
+    outputs_limits(DEFAULT_LIMITS),
+    outputs_revision(-1),
+    valid(utils::sparse_set(geometry.conn_unit_count(), true)),
+    total_wire_length(0),
+    wire_lengths_revision(-1) {
+}
+
+Walker::Walker(const Geometry &geometry, const connections_t &connections)
+  : Walker(geometry) {
+  for(int input_id = 0; input_id < connections.size() && input_id < conns.size(); ++ input_id) {
+    if(connections[input_id] != -1) {
+      rewire(input_id, connections[input_id]);
+    }
+  }
+}
+
+void Walker::count_unit(int unit_id, int sign) {
+  int in_unit_id1 = conns[unit_id * 2];
+  int in_unit_id2 = conns[unit_id * 2 + 1];
+
+  array_input_conn_count += sign * ((in_unit_id1 == array_input_id) + (in_unit_id2 == array_input_id));
+
+  if(in_unit_id1 != -1 && in_unit_id2 != -1) {
+    both_inputs_count += sign;
+  } else if(in_unit_id1 != -1 || in_unit_id2 != -1) {
+    one_input_count += sign;
+  }
+}
+
+void Walker::record(const WalkerChange &change) {
+  if(journal->size() == MAX_JOURNAL_SIZE) {
+    // caches at the current revision can still replay from here on
+    first_revision += journal->size();
+    journal = utils::cow_ref<vector<WalkerChange>>();
+  }
+  journal.mutable_value().push_back(change);
+}
+
+const WalkerChange *Walker::changes_since(long cache_revision, int *change_count) const {
+  if(cache_revision < first_revision) {
+    return nullptr;
+  }
+
+  int first_change = cache_revision - first_revision;
+  for(int cid = first_change; cid < journal->size(); ++ cid) {
+    if((*journal)[cid].input_id == -1) {
+      // the walker was reset since
+      return nullptr;
+    }
+  }
+
+  *change_count = journal->size() - first_change;
+  return journal->data() + first_change;
+}
+
+connections_t Walker::connections() const {
+  connections_t plain_conns;
+  conns.copy_to(& plain_conns);
+  return plain_conns;
+}
+
+void Walker::rewire(int input_id, int unit_id) {
+  int old_unit_id = conns[input_id];
+  if(old_unit_id == unit_id) {
+    return;
+  }
+
+  int wired_unit_id = input_id / 2;
+
+  count_unit(wired_unit_id, -1);
+  conns.set(input_id, unit_id);
+  count_unit(wired_unit_id, 1);
+
+  // only touch the set when the unit changes state, so that a clone keeps sharing it otherwise
+  bool is_wired = conns[wired_unit_id * 2] != -1 || conns[wired_unit_id * 2 + 1] != -1;
+  if(is_wired && ! wired->contains(wired_unit_id)) {
+    wired.mutable_value().insert(wired_unit_id);
+  } else if(! is_wired && wired->contains(wired_unit_id)) {
+    wired.mutable_value().erase(wired_unit_id);
+  }
+
+  record({input_id, old_unit_id, unit_id});
+
+  if(old_unit_id != -1) {
+    closure.remove_edge(old_unit_id, wired_unit_id, outgoing_connections());
+  }
+  if(unit_id != -1) {
+    closure.add_edge(unit_id, wired_unit_id);
+  }
+}
+
+void Walker::clone_from(const Walker &other) {
+  // the clone continues from the journal of its source, so the caches stay
+  // valid, and every member is either shared or small
+  *this = other;
+}
+
+void Walker::reset() {
+  conns.fill(-1);
+  wired = utils::sparse_set(geom->unit_count());
+
+  array_input_conn_count = 0;
+  one_input_count = 0;
+  both_inputs_count = 0;
+
+  closure.clear();
+
+  record({-1, -1, -1});
+}
+
+std::vector<std::vector<int> > const & Walker::outgoing_connections() {
+  if(outgoing_revision == revision()) {
+    return *outgoing;
+  }
+
+  int change_count = 0;
+  const WalkerChange * changes = changes_since(outgoing_revision, & change_count);
+
+  if(changes == nullptr) {
+    // rebuild from the wired units, the edges come sorted
+    vector<vector<int>> rebuilt(geom->conn_unit_count());
+    for(auto & edge : compute_wired_edges(conns, wired_units())) {
+      rebuilt[edge.first].push_back(edge.second);
+    }
+    outgoing = std::move(rebuilt);
+  } else {
+    // move the rewired units between the outgoing connections of their old and new upstream units
+    auto & out_conns = outgoing.mutable_value();
+    for(int cid = 0; cid < change_count; ++ cid) {
+      auto & change = changes[cid];
+      int unit_id = change.input_id / 2;
+
+      if(change.old_unit_id != -1) {
+        auto & old_conns = out_conns[change.old_unit_id];
+        old_conns.erase(find(old_conns.begin(), old_conns.end(), unit_id));
+      }
+      if(change.new_unit_id != -1) {
+        auto & new_conns = out_conns[change.new_unit_id];
+        new_conns.insert(upper_bound(new_conns.begin(), new_conns.end(), unit_id), unit_id);
+      }
+    }
+  }
+
+  outgoing_revision = revision();
+  return *outgoing;
+}
+
+std::vector<int> const & Walker::propagation_order() {
+  if(order_revision != revision()) {
+    order = compute_propagation_order(conns, wired_units(), *geom);
+    order_revision = revision();
+  }
+  return *order;
+}
+
+unit_outputs_t const & Walker::unit_outputs(const PropagationLimits &limits, PropagationStats *stats) {
+  bool same_limits = outputs_limits.max_degree == limits.max_degree &&
+                     outputs_limits.max_terms == limits.max_terms;
+  if(outputs_revision == revision() && same_limits) {
+    return *outputs;
+  }
+
+  int change_count = 0;
+  const WalkerChange * changes = changes_since(outputs_revision, & change_count);
+
+  if(changes == nullptr || ! same_limits) {
+    outputs = compute_unit_outputs(conns, propagation_order(), *geom, limits, stats);
+
+    utils::sparse_set valid_set(geom->conn_unit_count(), true);
+    for(int unit_id = 0; unit_id < outputs->size(); ++ unit_id) {
+      if((*outputs)[unit_id].is_valid) {
+        valid_set.insert(unit_id);
+      }
+    }
+    valid = std::move(valid_set);
+  } else {
+    vector<int> changed_units;
+    for(int cid = 0; cid < change_count; ++ cid) {
+      changed_units.push_back(changes[cid].input_id / 2);
+    }
+    update_outputs_downstream(changed_units, limits, stats);
+  }
+
+  outputs_limits = limits;
+  outputs_revision = revision();
+  return *outputs;
+}
+
+utils::sparse_set const & Walker::valid_units(const PropagationLimits &limits, PropagationStats *stats) {
+  unit_outputs(limits, stats);
+  return *valid;
+}
+
+void Walker::set_output(int unit_id, UnitOutput &&output) {
+  auto & unit_outs = outputs.mutable_value();
+  unit_outs[unit_id] = std::move(output);
+  if(unit_outs[unit_id].is_valid) {
+    valid.mutable_value().insert(unit_id);
+  } else if(valid->contains(unit_id)) {
+    valid.mutable_value().erase(unit_id);
+  }
+}
+
+void Walker::update_outputs_downstream(const std::vector<int> &changed_units,
+                                       const PropagationLimits &limits, PropagationStats *stats) {
+  auto & out_conns = outgoing_connections();
+  if(scratch.size() < geom->conn_unit_count()) {
+    scratch.resize(geom->conn_unit_count(), 0);
+  }
+
+  /* Collect the downstream cone of the changed units. For each unit in the
+   * cone, the scratch space counts its inputs coming from other units in the
+   * cone, plus one to mark it as part of the cone.
+   */
+  vector<int> cone;
+  for(int unit_id : changed_units) {
+    if(scratch[unit_id] == 0) {
+      scratch[unit_id] = 1;
+      cone.push_back(unit_id);
+    }
+  }
+  for(int pos = 0; pos < cone.size(); ++ pos) {
+    for(int downstream_unit_id : out_conns[cone[pos]]) {
+      if(scratch[downstream_unit_id] == 0) {
+        scratch[downstream_unit_id] = 1;
+        cone.push_back(downstream_unit_id);
+      }
+      ++ scratch[downstream_unit_id];
+    }
+  }
+
+  // walk the cone in topological order, starting with units whose inputs are all outside of it
+  vector<int> ready;
+  for(int unit_id : cone) {
+    if(scratch[unit_id] == 1) {
+      ready.push_back(unit_id);
+    }
+  }
+
+  for(int pos = 0; pos < ready.size(); ++ pos) {
+    int unit_id = ready[pos];
+    int in_unit_id1 = conns[unit_id * 2];
+    int in_unit_id2 = conns[unit_id * 2 + 1];
+
+    if(in_unit_id1 != -1 && in_unit_id2 != -1 &&
+       (*outputs)[in_unit_id1].has_output && (*outputs)[in_unit_id2].has_output) {
+      set_output(unit_id, compute_one_unit_output(
+        geom->unit_type(unit_id),
+        (*outputs)[in_unit_id1],
+        (*outputs)[in_unit_id2],
+        limits,
+        stats
+      ));
+    } else {
+      set_output(unit_id, {false, false, {}});
+    }
+
+    for(int downstream_unit_id : out_conns[unit_id]) {
+      if(-- scratch[downstream_unit_id] == 1) {
+        ready.push_back(downstream_unit_id);
+      }
+    }
+  }
+
+  // units left over are part of a cycle and never get a signal
+  for(int unit_id : cone) {
+    if(scratch[unit_id] > 1) {
+      set_output(unit_id, {false, false, {}});
+    }
+    scratch[unit_id] = 0;
+  }
+}
+
+void Walker::downstream_cone(int unit_id, std::vector<int> *cone) const {
+  closure.descendants(unit_id, cone);
+  if(! closure.reaches(unit_id, unit_id)) {
+    cone->push_back(unit_id);
+  }
+}
+
+void Walker::connectable_units(int unit_id, const PropagationLimits &limits,
+                               PropagationStats *stats, std::vector<int> *units) {
+  auto & valid_set = valid_units(limits, stats);
+
+  // the valid units are ordered, so the result only depends on the connections
+  units->clear();
+  for(int valid_unit_id : valid_set.values()) {
+    if(valid_unit_id != unit_id && ! closure.reaches(unit_id, valid_unit_id)) {
+      units->push_back(valid_unit_id);
+    }
+  }
+}
+
+int Walker::sample_connectable_unit(int unit_id, const PropagationLimits &limits,
+                                    PropagationStats *stats, std::mt19937 *generator) {
+  auto & valid_set = valid_units(limits, stats);
+
+  // picks that would create a cycle are rejected, which keeps the pick uniform
+  uniform_int_distribution<int> dist_positions(0, valid_set.size() - 1);
+  for(int attempt = 0; attempt < CONNECT_ATTEMPTS; ++ attempt) {
+    int candidate = valid_set.at(dist_positions(*generator));
+    if(candidate != unit_id && ! closure.reaches(unit_id, candidate)) {
+      return candidate;
+    }
+  }
+
+  vector<int> units;
+  connectable_units(unit_id, limits, stats, & units);
+  uniform_int_distribution<int> dist_units(0, units.size() - 1);
+  return units[dist_units(*generator)];
+}
+
+int Walker::wire_lengths() {
+  if(wire_lengths_revision == revision()) {
+    return total_wire_length;
+  }
+
+  int change_count = 0;
+  const WalkerChange * changes = changes_since(wire_lengths_revision, & change_count);
+  auto & out_conns = outgoing_connections();
+
+  // only the wires starting at the units that lost or gained a connection change
+  vector<int> dirty_units;
+  if(changes == nullptr) {
+    unit_wire_lengths = vector<int>(geom->unit_count(), 0);
+    total_wire_length = 0;
+
+    for(int unit_id : wired_units()) {
+      dirty_units.push_back(conns[unit_id * 2]);
+      dirty_units.push_back(conns[unit_id * 2 + 1]);
+    }
+  } else {
+    for(int cid = 0; cid < change_count; ++ cid) {
+      dirty_units.push_back(changes[cid].old_unit_id);
+      dirty_units.push_back(changes[cid].new_unit_id);
+    }
+  }
+
+  sort(dirty_units.begin(), dirty_units.end());
+  dirty_units.erase(unique(dirty_units.begin(), dirty_units.end()), dirty_units.end());
+
+  auto & lengths = unit_wire_lengths.mutable_value();
+  vector<int> wire;
+  for(int unit_id : dirty_units) {
+    // wires from the input of the array are not accounted for
+    if(unit_id == -1 || unit_id >= geom->unit_count()) {
+      continue;
+    }
+
+    total_wire_length -= lengths[unit_id];
+    lengths[unit_id] = 0;
+
+    if(! out_conns[unit_id].empty()) {
+      // store all points of the wire, including source
+      wire = out_conns[unit_id];
+      wire.push_back(unit_id);
+      lengths[unit_id] = compute_one_wire_length(wire, *geom);
+    }
+
+    total_wire_length += lengths[unit_id];
+  }
+
+  wire_lengths_revision = revision();
+  return total_wire_length;
+}
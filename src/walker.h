@@ -0,0 +1,203 @@
+#ifndef WALKER_H
+#define WALKER_H
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "definitions.h"
+#include "propagation.h"
+#include "utils/sparse_set.h"
+#include "utils/reachability.h"
+#include "utils/cow_array.h"
+
+/* One entry of the change journal of a walker */
+struct WalkerChange {
+  // id of the input that was rewired, or -1 if the whole walker was reset
+  int input_id;
+
+  // unit connected to the input before and after the change
+  int old_unit_id;
+  int new_unit_id;
+};
+
+/* One candidate circuit of the stochastic search.
+ *
+ * Besides the wire connections, a walker keeps track of which units are
+ * wired i.e. have at least one of their inputs connected. Early in the search
+ * and on very large arrays only a few units are, so propagation, counting
+ * and wire lengths can be computed from this list alone.
+ *
+ * It also maintains the structural counters used by the score, so that they
+ * come for free instead of requiring a scan of all connections, and the
+ * transitive closure of its connections, so that checking for cycles and
+ * finding the units downstream of another take no graph traversal.
+ *
+ * All changes go through rewire(), clone_from() and reset(), which keep the
+ * above in sync and log every change in a journal. Each revision of the
+ * walker is a position in the journal.
+ *
+ * Connections and the closure are stored copy-on-write in small chunks, so a
+ * clone shares them with its source and only copies the chunks that either
+ * of them later changes. The set of wired units, the journal and the caches
+ * below are shared the same way as a whole, and only copied by the first of
+ * the two walkers to update them. Cloning a walker is thus O(1) and a clone
+ * that is only read, e.g. a checkpoint or a migrant, never copies anything.
+ *
+ * The walker owns caches for everything derived from its connections: the
+ * outgoing connections of each unit, the propagation order, the unit outputs
+ * and the wire lengths. Each cache remembers the revision it was computed at
+ * and is brought up to date on access, either by replaying the changes logged
+ * since then or by a full rebuild when the journal no longer has them.
+ */
+class Walker {
+  std::shared_ptr<const Geometry> geom;
+
+  utils::cow_array<int> conns;
+  utils::cow_ref<utils::sparse_set> wired;
+
+  int array_input_id;
+
+  // number of inputs connected to the input of the array
+  int array_input_conn_count;
+
+  // number of units with exactly one input and with both inputs connected
+  int one_input_count;
+  int both_inputs_count;
+
+  // which units are downstream of which
+  utils::reachability closure;
+
+  /* Journal of the most recent changes: journal[i] took the walker from
+   * revision first_revision + i to the next one. Older entries are dropped.
+   */
+  utils::cow_ref<std::vector<WalkerChange>> journal;
+  long first_revision;
+
+  // cached outgoing connections of each unit, sorted
+  utils::cow_ref<std::vector<std::vector<int>>> outgoing;
+  long outgoing_revision;
+
+  // cached propagation order
+  utils::cow_ref<std::vector<int>> order;
+  long order_revision;
+
+  // cached unit outputs, the limits they were computed with and the units
+  // whose output is valid
+  utils::cow_ref<unit_outputs_t> outputs;
+  propagation::PropagationLimits outputs_limits;
+  long outputs_revision;
+  utils::cow_ref<utils::sparse_set> valid;
+
+  // cached length of the wire starting at each unit and their sum
+  utils::cow_ref<std::vector<int>> unit_wire_lengths;
+  int total_wire_length;
+  long wire_lengths_revision;
+
+  // add (sign = 1) or remove (sign = -1) the contribution of a unit to the counters
+  void count_unit(int unit_id, int sign);
+
+  void record(WalkerChange const & change);
+
+  // recompute the outputs of the given units and of everything downstream of them
+  void update_outputs_downstream(std::vector<int> const & changed_units,
+                                 propagation::PropagationLimits const & limits,
+                                 propagation::PropagationStats * stats);
+
+  void set_output(int unit_id, UnitOutput && output);
+
+  // the changes logged after the given revision, or null if a cache at that
+  // revision must be rebuilt from scratch
+  WalkerChange const * changes_since(long cache_revision, int * change_count) const;
+
+public:
+  // a walker with all inputs disconnected
+  Walker(Geometry const & geometry = default_geometry());
+
+  // a walker wired with the given connections, e.g. those of a BestCircuit
+  Walker(Geometry const & geometry, connections_t const & connections);
+
+  Geometry const & geometry() const { return *geom; }
+
+  // a plain copy of the connections
+  connections_t connections() const;
+
+  // the connections as stored, for reading them without a copy
+  utils::cow_array<int> const & connection_array() const { return conns; }
+
+  // id of the unit connected to the given input, or -1
+  int input(int input_id) const { return conns[input_id]; }
+
+  /* Mutation API */
+
+  // connect an input to the output of a unit, -1 disconnects it
+  void rewire(int input_id, int unit_id);
+
+  // become a copy of another walker, including its caches and journal,
+  // all shared with it until either walker changes them
+  void clone_from(Walker const & other);
+
+  // disconnect all inputs
+  void reset();
+
+  // the current position in the journal
+  long revision() const { return first_revision + journal->size(); }
+
+  /* Incrementally maintained state */
+
+  // ids of the units with at least one input connected, in no particular order
+  std::vector<int> const & wired_units() const { return wired->values(); }
+
+  bool is_array_input_connected() const { return array_input_conn_count > 0; }
+
+  int count_one_input_connected() const { return one_input_count; }
+
+  int count_both_inputs_connected() const { return both_inputs_count; }
+
+  // whether the output of a unit feeds into another one, directly or not
+  bool is_upstream(int upstream_unit_id, int downstream_unit_id) const {
+    return closure.reaches(upstream_unit_id, downstream_unit_id);
+  }
+
+  /* Derived caches, brought up to date on access */
+
+  // ids of the units each unit output connects to
+  std::vector<std::vector<int>> const & outgoing_connections();
+
+  // see propagation::compute_propagation_order
+  std::vector<int> const & propagation_order();
+
+  /* See propagation::compute_unit_outputs, stats only count outputs that are
+   * recomputed. After a few rewires only the units downstream of them are.
+   */
+  unit_outputs_t const & unit_outputs(propagation::PropagationLimits const & limits,
+                                      propagation::PropagationStats * stats = nullptr);
+
+  // ids of the units with a valid output, including the input of the array,
+  // in increasing order
+  utils::sparse_set const & valid_units(propagation::PropagationLimits const & limits,
+                                        propagation::PropagationStats * stats = nullptr);
+
+  // ids of the given unit and of all units downstream of it
+  void downstream_cone(int unit_id, std::vector<int> * cone) const;
+
+  /* Units that an input of the given unit can be connected to: those with a
+   * valid output that are not in its downstream cone, so that connecting them
+   * never creates a cycle. The input of the array is always one of them.
+   * They come sorted.
+   */
+  void connectable_units(int unit_id, propagation::PropagationLimits const & limits,
+                         propagation::PropagationStats * stats, std::vector<int> * units);
+
+  /* One of the connectable units, uniformly at random. Valid units are drawn
+   * until one is not downstream of the given unit, the full list is only
+   * built after a few misses. The result depends on the connections and the
+   * generator only.
+   */
+  int sample_connectable_unit(int unit_id, propagation::PropagationLimits const & limits,
+                              propagation::PropagationStats * stats, std::mt19937 * generator);
+
+  // see scoring::compute_wire_lengths
+  int wire_lengths();
+};
+
+#endif // WALKER_H
@@ -0,0 +1,58 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include "../src/beam_search.h"
+#include "../src/scoring.h"
+
+using namespace std;
+using namespace scoring;
+using namespace propagation;
+
+TEST_CASE("Can run beam search", "[beam_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  poly_t poly {3, 7};
+
+  BeamSearch search(poly, params);
+  search.set_verbose(false);
+  search.set_beam_width(32);
+  auto score = search.search(6);
+  REQUIRE(score.times_function_recovered > 0);
+
+  // the best circuit recovers the target and scores the same as in a stochastic search
+  vector<Walker> best;
+  vector<double> scores;
+  search.get_best_walkers(3, & best, & scores);
+  REQUIRE(best.size() == 3);
+  REQUIRE(search.best_circuits()->snapshot()->front().function_recovered);
+
+  int wire_lengths = 0;
+  ScoringPlan plan = make_scoring_plan({7, 3}, DEFAULT_LIMITS.max_degree);
+  auto rescored = score_walker(& best[0], plan, params, DEFAULT_LIMITS, nullptr, & wire_lengths);
+  REQUIRE(rescored.best_score == scores[0]);
+  REQUIRE(rescored.times_function_recovered > 0);
+}
+
+TEST_CASE("Can run beam search on several threads", "[beam_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  poly_t poly {5, 2, 1};
+
+  BeamSearch sequential(poly, params);
+  sequential.set_verbose(false);
+  sequential.set_beam_width(16);
+  auto sequential_score = sequential.search(5);
+
+  BeamSearch parallel(poly, params);
+  parallel.set_verbose(false);
+  parallel.set_beam_width(16);
+  parallel.set_thread_count(3);
+  auto parallel_score = parallel.search(5);
+
+  // expansion is split between threads, the beams are merged in a fixed order
+  REQUIRE(sequential_score.best_score == parallel_score.best_score);
+  auto sequential_best = sequential.best_circuits()->snapshot();
+  auto parallel_best = parallel.best_circuits()->snapshot();
+  REQUIRE(sequential_best->size() == parallel_best->size());
+  for(int pos = 0; pos < sequential_best->size(); ++ pos) {
+    REQUIRE((*sequential_best)[pos].conns == (*parallel_best)[pos].conns);
+  }
+}
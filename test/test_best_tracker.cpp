@@ -0,0 +1,86 @@
+#include "../extern/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "../src/best_tracker.h"
+#include "../src/stochastic_search.h"
+#include "../src/island_search.h"
+#include "../src/scoring.h"
+
+using namespace std;
+using namespace scoring;
+
+TEST_CASE("Can keep the best circuits offered from several threads", "[best_tracker]" ) {
+  BestTracker tracker(5);
+
+  // each thread offers distinct circuits, each of them twice
+  atomic<bool> snapshots_valid(true);
+  vector<thread> threads;
+  for(int thread_id = 0; thread_id < 4; ++ thread_id) {
+    threads.emplace_back([&tracker, &snapshots_valid, thread_id]() {
+      mt19937 random_generator(thread_id);
+      uniform_real_distribution<double> dist_scores(0, 100);
+      for(int cid = 0; cid < 500; ++ cid) {
+        BestCircuit circuit{dist_scores(random_generator), {thread_id, cid}, cid, false};
+        tracker.offer(circuit);
+        tracker.offer(circuit);
+
+        // snapshots are always sorted and never too large
+        auto snapshot = tracker.snapshot();
+        if(snapshot->size() > 5) {
+          snapshots_valid = false;
+        }
+        for(int pos = 1; pos < snapshot->size(); ++ pos) {
+          if((*snapshot)[pos - 1].score < (*snapshot)[pos].score) {
+            snapshots_valid = false;
+          }
+        }
+      }
+    });
+  }
+  for(auto & offering_thread : threads) {
+    offering_thread.join();
+  }
+  REQUIRE(snapshots_valid);
+
+  // replay the same offers to find the expected top 5
+  vector<double> all_scores;
+  for(int thread_id = 0; thread_id < 4; ++ thread_id) {
+    mt19937 random_generator(thread_id);
+    uniform_real_distribution<double> dist_scores(0, 100);
+    for(int cid = 0; cid < 500; ++ cid) {
+      all_scores.push_back(dist_scores(random_generator));
+    }
+  }
+  sort(all_scores.begin(), all_scores.end(), greater<double>());
+
+  auto best = tracker.snapshot();
+  REQUIRE(best->size() == 5);
+  for(int pos = 0; pos < 5; ++ pos) {
+    REQUIRE((*best)[pos].score == all_scores[pos]);
+  }
+  REQUIRE(! tracker.would_accept(all_scores[4]));
+  REQUIRE(tracker.would_accept(all_scores[0] + 1));
+}
+
+TEST_CASE("Can keep the best circuits of a search", "[best_tracker]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  IslandSearch search(poly, 2, 10, params);
+  search.set_seed(43);
+  auto best_score = search.train(5, 10, 10, np);
+
+  // the islands share the tracker, which saw the best score of both
+  auto best = search.best_circuits()->snapshot();
+  REQUIRE(search.best_circuits() == search.island(1).best_circuits());
+  REQUIRE(! best->empty());
+  REQUIRE(best->front().score == best_score.best_score);
+  REQUIRE(best->front().function_recovered == (best_score.times_function_recovered > 0));
+  REQUIRE(best->front().wire_length == compute_wire_lengths(best->front().conns));
+}
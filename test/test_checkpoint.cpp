@@ -0,0 +1,96 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include "../src/stochastic_search.h"
+#include "../src/serialization.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+using namespace serialization;
+
+TEST_CASE("Can encode and decode a search checkpoint", "[checkpoint]" ) {
+  Walker walker(default_geometry());
+  walker.rewire(0, walker.geometry().array_input_id());
+  walker.rewire(5, 0);
+
+  SearchCheckpoint checkpoint;
+  checkpoint.next_iteration = 4;
+  checkpoint.iteration_count = 10;
+  checkpoint.random_state = "1 2 3";
+  checkpoint.walkers.push_back(walker);
+  checkpoint.best_circuits.push_back(BestCircuit {0.25, walker.connections(), 7, true});
+
+  bytes_t bytes;
+  encode_checkpoint(checkpoint, & bytes);
+
+  SearchCheckpoint decoded;
+  REQUIRE(decode_checkpoint(bytes, & decoded));
+  REQUIRE(decoded.next_iteration == 4);
+  REQUIRE(decoded.iteration_count == 10);
+  REQUIRE(decoded.random_state == "1 2 3");
+  REQUIRE(decoded.walkers.size() == 1);
+  REQUIRE(decoded.walkers[0].connections() == walker.connections());
+  REQUIRE(decoded.best_circuits.size() == 1);
+  REQUIRE(decoded.best_circuits[0].score == 0.25);
+  REQUIRE(decoded.best_circuits[0].conns == walker.connections());
+  REQUIRE(decoded.best_circuits[0].wire_length == 7);
+  REQUIRE(decoded.best_circuits[0].function_recovered);
+
+  // truncated data is rejected rather than half decoded
+  bytes.resize(bytes.size() - 1);
+  REQUIRE(! decode_checkpoint(bytes, & decoded));
+
+  // so are circuits with units outside the array of the walkers
+  checkpoint.best_circuits[0].conns[5] = walker.geometry().array_input_id() + 1;
+  bytes.clear();
+  encode_checkpoint(checkpoint, & bytes);
+  REQUIRE(! decode_checkpoint(bytes, & decoded));
+
+  // and circuits for another number of inputs
+  checkpoint.best_circuits[0].conns = walker.connections();
+  checkpoint.best_circuits[0].conns.pop_back();
+  bytes.clear();
+  encode_checkpoint(checkpoint, & bytes);
+  REQUIRE(! decode_checkpoint(bytes, & decoded));
+}
+
+TEST_CASE("Can resume stochastic search from a checkpoint", "[checkpoint]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  string directory = make_temp_directory();
+  string path = directory + "/search.ckpt";
+
+  StochasticSearch interrupted(poly, 12, params);
+  interrupted.set_seed(43);
+  interrupted.set_verbose(false);
+  interrupted.set_checkpoint(path, 4);
+  interrupted.train(6, 10, 10, np);
+  interrupted.flush_checkpoints();
+
+  // the checkpoint holds the state after 4 of the 6 iterations
+  StochasticSearch resumed(poly, 12, params);
+  resumed.set_verbose(false);
+  REQUIRE(resumed.resume(path));
+  resumed.train(6, 10, 10, np);
+
+  vector<Walker> interrupted_walkers;
+  vector<Walker> resumed_walkers;
+  interrupted.get_best_walkers(12, & interrupted_walkers);
+  resumed.get_best_walkers(12, & resumed_walkers);
+  for(int wid = 0; wid < 12; ++ wid) {
+    REQUIRE(interrupted_walkers[wid].connections() == resumed_walkers[wid].connections());
+  }
+  REQUIRE(interrupted.best_circuits()->snapshot()->front().score ==
+          resumed.best_circuits()->snapshot()->front().score);
+
+  // a search with another population does not take the checkpoint
+  StochasticSearch other(poly, 8, params);
+  REQUIRE(! other.resume(path));
+  REQUIRE(! other.resume(directory + "/missing.ckpt"));
+
+  remove_directory(directory);
+}
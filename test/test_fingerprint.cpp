@@ -0,0 +1,40 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include "../src/fingerprint.h"
+#include "../src/propagation.h"
+#include "../src/definitions.h"
+
+using namespace std;
+using namespace fingerprint;
+using namespace propagation;
+
+TEST_CASE("Can compute fingerprints of unit outputs", "[fingerprint]" ) {
+  connections_t conns(CONN_INPUT_COUNT, -1);
+
+  // x * x on the multiplier of the first row
+  int mult_id = 1;
+  conns[mult_id * 2] = ARRAY_INPUT_ID;
+  conns[mult_id * 2 + 1] = ARRAY_INPUT_ID;
+
+  // x^2 + x on the adder of the second row
+  int add_id = 3;
+  conns[add_id * 2] = mult_id;
+  conns[add_id * 2 + 1] = ARRAY_INPUT_ID;
+
+  // (x^2 + x) / x^2 on the divider of the second row
+  int div_id = 5;
+  conns[div_id * 2] = add_id;
+  conns[div_id * 2 + 1] = mult_id;
+
+  auto order = compute_propagation_order(conns);
+  REQUIRE(order == vector<int>({(int) ARRAY_INPUT_ID, mult_id, add_id, div_id}));
+
+  auto unit_fingerprints = compute_unit_fingerprints(conns, order);
+  REQUIRE(unit_fingerprints[mult_id] == compute_poly_fingerprint({2}));
+  REQUIRE(unit_fingerprints[add_id] == compute_poly_fingerprint({2, 1}));
+  REQUIRE(unit_fingerprints[div_id] == compute_poly_fingerprint({0, -1}));
+
+  REQUIRE(has_matching_unit(unit_fingerprints, order, compute_poly_fingerprint({2, 1})));
+  REQUIRE(! has_matching_unit(unit_fingerprints, order, compute_poly_fingerprint({3, 1})));
+}
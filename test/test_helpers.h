@@ -0,0 +1,38 @@
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include "../extern/catch.hpp"
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include "../src/walker.h"
+
+/* Helpers shared by the tests that go through files or need arbitrary walkers */
+
+// a fresh directory under /tmp, to be removed with remove_directory
+inline std::string make_temp_directory() {
+  char path[] = "/tmp/circuit-planner-XXXXXX";
+  REQUIRE(mkdtemp(path) != nullptr);
+  return path;
+}
+
+inline void remove_directory(std::string const & directory) {
+  REQUIRE(system(("rm -rf " + directory).c_str()) == 0);
+}
+
+// a walker with a few random rewires, cycles and dangling inputs included
+inline Walker make_random_walker(Geometry const & geometry, int seed) {
+  std::mt19937 random_generator(seed);
+  std::uniform_int_distribution<int> dist_inputs(0, geometry.conn_input_count() - 1);
+  std::uniform_int_distribution<int> dist_units(-1, geometry.array_input_id());
+
+  Walker walker(geometry);
+  for(int step = 0; step < 80; ++ step) {
+    walker.rewire(dist_inputs(random_generator), dist_units(random_generator));
+  }
+  return walker;
+}
+
+#endif // TEST_HELPERS_H
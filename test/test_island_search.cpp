@@ -0,0 +1,90 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include "../src/island_search.h"
+#include "../src/scoring.h"
+#include "../src/utils/spsc_ring.h"
+
+using namespace std;
+using namespace scoring;
+
+TEST_CASE("Can pass values between threads through a ring", "[island_search]" ) {
+  utils::spsc_ring<vector<int>> ring(3);
+
+  thread producer([&ring]() {
+    for(int value = 0; value < 1000; ++ value) {
+      vector<int> batch(value % 5, value);
+      while(! ring.push(std::move(batch))) {
+        this_thread::yield();
+      }
+    }
+  });
+
+  vector<int> batch;
+  for(int value = 0; value < 1000; ++ value) {
+    while(! ring.pop(& batch)) {
+      this_thread::yield();
+    }
+    REQUIRE(batch == vector<int>(value % 5, value));
+  }
+  producer.join();
+
+  REQUIRE(! ring.pop(& batch));
+}
+
+TEST_CASE("Can exchange the best walkers between searches", "[island_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  StochasticSearch source(poly, 10, params);
+  source.set_seed(1);
+  source.set_verbose(false);
+  source.train(3, 5, 5, np);
+
+  vector<Walker> best;
+  source.get_best_walkers(3, & best);
+  REQUIRE(best.size() == 3);
+
+  // empty walkers score the lowest, so the migrants replace them
+  StochasticSearch target(poly, 10, params);
+  target.replace_worst_walkers(best);
+
+  // the source ranked them by their scores before the noise, the target by their current ones
+  vector<Walker> target_best;
+  target.get_best_walkers(3, & target_best);
+  vector<connections_t> expected_conns;
+  vector<connections_t> target_conns;
+  for(int wid = 0; wid < 3; ++ wid) {
+    expected_conns.push_back(best[wid].connections());
+    target_conns.push_back(target_best[wid].connections());
+  }
+  sort(expected_conns.begin(), expected_conns.end());
+  sort(target_conns.begin(), target_conns.end());
+  REQUIRE(target_conns == expected_conns);
+
+  // migrants for another array are left out
+  StochasticSearch larger(poly, 10, params, make_geometry(100, 3));
+  larger.replace_worst_walkers(best);
+  for(int wid = 0; wid < 10; ++ wid) {
+    REQUIRE(larger.walker(wid).wired_units().empty());
+  }
+}
+
+TEST_CASE("Can run island search", "[island_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  IslandSearch search(poly, 3, 10, params);
+  search.set_seed(39);
+  search.set_migration({2, 2});
+  auto best = search.train(6, 10, 10, np);
+
+  REQUIRE(search.best_per_island().size() == 3);
+  for(auto & island_best : search.best_per_island()) {
+    REQUIRE(island_best.best_score <= best.best_score);
+  }
+}
@@ -0,0 +1,136 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <random>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/island_transport.h"
+#include "../src/serialization.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+using namespace serialization;
+
+TEST_CASE("Can encode and decode walkers", "[island_transport]" ) {
+  vector<Walker> walkers;
+  walkers.push_back(make_random_walker(default_geometry(), 1));
+  walkers.push_back(make_random_walker(make_geometry(200, 3), 2));
+  walkers.push_back(make_random_walker(Geometry{7, {1, 0}}, 3));
+  walkers.push_back(Walker());
+
+  bytes_t bytes;
+  encode_walkers(walkers, & bytes);
+
+  vector<Walker> decoded;
+  REQUIRE(decode_walkers(bytes, & decoded));
+  REQUIRE(decoded.size() == walkers.size());
+  for(int wid = 0; wid < walkers.size(); ++ wid) {
+    REQUIRE(decoded[wid].geometry().rows == walkers[wid].geometry().rows);
+    REQUIRE(decoded[wid].geometry().coll_types == walkers[wid].geometry().coll_types);
+    REQUIRE(decoded[wid].connections() == walkers[wid].connections());
+  }
+
+  // truncated or corrupted batches are rejected
+  bytes_t truncated(bytes.begin(), bytes.end() - 1);
+  REQUIRE(! decode_walkers(truncated, & decoded));
+  bytes[0] ^= 1;
+  REQUIRE(! decode_walkers(bytes, & decoded));
+}
+
+TEST_CASE("Can send walkers between island sockets", "[island_transport]" ) {
+  string directory = make_temp_directory();
+  IslandTransport transport0(directory, 0);
+  IslandTransport transport1(directory, 1);
+  REQUIRE(transport0.is_open());
+  REQUIRE(transport1.is_open());
+
+  vector<Walker> walkers {make_random_walker(default_geometry(), 4), make_random_walker(default_geometry(), 5)};
+  REQUIRE(transport0.send(1, walkers));
+
+  // nothing is listening for island 2
+  REQUIRE(! transport0.send(2, walkers));
+
+  vector<Walker> received;
+  REQUIRE(! transport0.receive(& received));
+  REQUIRE(transport1.receive(& received));
+  REQUIRE(received.size() == 2);
+  REQUIRE(received[0].connections() == walkers[0].connections());
+  REQUIRE(received[1].connections() == walkers[1].connections());
+  REQUIRE(! transport1.receive(& received));
+
+  remove_directory(directory);
+}
+
+TEST_CASE("Can run islands in separate processes", "[island_transport]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  string directory = make_temp_directory();
+
+  pid_t child_pid = fork();
+  REQUIRE(child_pid != -1);
+
+  int island_id = child_pid == 0 ? 1 : 0;
+  ProcessIsland island(poly, 10, params, directory, island_id, 2);
+  island.island().set_seed(40 + island_id);
+  island.set_migration({2, 2});
+  auto best = island.train(6, 10, 10, np);
+
+  if(child_pid == 0) {
+    _exit(best.best_score > 0 ? 0 : 1);
+  }
+
+  int status = 0;
+  waitpid(child_pid, & status, 0);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  // both islands left their best walker behind
+  Walker walker;
+  REQUIRE(load_best_walker(island.best_walker_path(), & walker));
+  REQUIRE(walker.connections() == island.island().best_circuits()->snapshot()->front().conns);
+  REQUIRE(load_best_walker(directory + "/island-1.best", & walker));
+  REQUIRE(! walker.wired_units().empty());
+
+  remove_directory(directory);
+}
+
+TEST_CASE("Can restart an island without replacing its best walker by a worse one", "[island_transport]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  string directory = make_temp_directory();
+
+  // the previous run saved a circuit with a score out of reach
+  Walker previous = make_random_walker(default_geometry(), 5);
+  double previous_score = 1e9;
+  {
+    ProcessIsland island(poly, 10, params, directory, 0, 1);
+    REQUIRE(save_best_walker(island.best_walker_path(), previous, previous_score));
+  }
+
+  ProcessIsland island(poly, 10, params, directory, 0, 1);
+  island.island().set_seed(41);
+  auto best = island.train(3, 10, 10, np);
+  REQUIRE(best.best_score < previous_score);
+
+  Walker walker;
+  double score = 0;
+  REQUIRE(load_best_walker(island.best_walker_path(), & walker, & score));
+  REQUIRE(score == previous_score);
+  REQUIRE(walker.connections() == previous.connections());
+
+  // while a fresh island saves what it scored
+  remove_directory(directory);
+  directory = make_temp_directory();
+  ProcessIsland fresh(poly, 10, params, directory, 0, 1);
+  fresh.island().set_seed(41);
+  best = fresh.train(3, 10, 10, np);
+  REQUIRE(load_best_walker(fresh.best_walker_path(), & walker, & score));
+  REQUIRE(score == fresh.island().best_circuits()->snapshot()->front().score);
+
+  remove_directory(directory);
+}
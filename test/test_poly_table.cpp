@@ -0,0 +1,96 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include "../src/poly_table.h"
+#include "../src/stochastic_search.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+using namespace propagation;
+
+static bool same_entries(PolyTable const & t1, PolyTable const & t2) {
+  auto & entries1 = t1.all_entries();
+  auto & entries2 = t2.all_entries();
+  if(entries1.size() != entries2.size()) {
+    return false;
+  }
+  for(int entry_id = 0; entry_id < entries1.size(); ++ entry_id) {
+    auto & e1 = entries1[entry_id];
+    auto & e2 = entries2[entry_id];
+    if(e1.poly != e2.poly || e1.depth != e2.depth || e1.tree_unit_count != e2.tree_unit_count ||
+       e1.unit_type != e2.unit_type || e1.operand1 != e2.operand1 || e1.operand2 != e2.operand2) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("Can enumerate the polynomials reachable from x", "[poly_table]" ) {
+  PolyTable table;
+  table.build({8, 3}, 3);
+
+  REQUIRE(table.find({1})->depth == 0);
+  REQUIRE(table.find({2})->depth == 1);
+  REQUIRE(table.find({4})->depth == 2);
+  REQUIRE(table.find({4})->tree_unit_count == 2);
+  REQUIRE(table.find({8})->depth == 3);
+  REQUIRE(table.find({8})->tree_unit_count == 3);
+  REQUIRE(table.find({1, 2})->depth == 2);
+  REQUIRE(table.find({3, 1})->tree_unit_count == 3);
+
+  // over the limits
+  REQUIRE(table.find({16}) == nullptr);
+  REQUIRE(table.find({8, 7, 6, 5}) == nullptr);
+
+  for(auto & entry : table.all_entries()) {
+    REQUIRE(entry.poly.size() <= 3);
+    REQUIRE(entry.poly.front() <= 8);
+    REQUIRE(entry.depth <= entry.tree_unit_count);
+  }
+
+  // threads only split the work
+  PolyTable parallel;
+  parallel.build({8, 3}, 3, 3);
+  REQUIRE(same_entries(table, parallel));
+}
+
+TEST_CASE("Can save polynomial tables and build circuits from them", "[poly_table]" ) {
+  string directory = make_temp_directory();
+
+  PolyTable table;
+  table.build({12, 3}, 3);
+  REQUIRE(table.save(directory + "/table"));
+
+  PolyTable loaded;
+  REQUIRE(loaded.load(directory + "/table"));
+  REQUIRE(same_entries(table, loaded));
+  REQUIRE(! loaded.load(directory + "/missing"));
+
+  Walker walker(default_geometry());
+  // x^2 is shared by both inputs of the adder, so fewer units than the bound are used
+  REQUIRE(table.build_walker({4, 2}, & walker));
+  REQUIRE(walker.wired_units().size() == 3);
+  REQUIRE(table.find({4, 2})->tree_unit_count == 4);
+  REQUIRE(! table.build_walker({9, 3}, & walker));
+
+  bool recovered = false;
+  auto & outputs = walker.unit_outputs(DEFAULT_LIMITS);
+  for(auto & output : outputs) {
+    recovered = recovered || (output.is_valid && output.poly == poly_t {4, 2});
+  }
+  REQUIRE(recovered);
+
+  // a search on a target in the table starts from its construction
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  StochasticSearch search({4, 2}, 8, params);
+  search.set_verbose(false);
+  search.set_poly_table(make_shared<PolyTable>(std::move(table)));
+  search.train(1, 1, 2, np);
+  REQUIRE(search.best_circuits()->snapshot()->front().function_recovered);
+
+  remove_directory(directory);
+}
@@ -0,0 +1,120 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <cstdlib>
+#include "../src/population_file.h"
+#include "../src/stochastic_search.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+
+TEST_CASE("Can store walkers in a population file", "[population_file]" ) {
+  string directory = make_temp_directory();
+
+  // the default array fits one byte per input, the larger one needs two
+  for(auto geometry : {default_geometry(), make_geometry(100, 3)}) {
+    string path = directory + "/population-" + to_string(geometry.rows);
+    vector<Walker> walkers;
+    for(int wid = 0; wid < 5; ++ wid) {
+      walkers.push_back(make_random_walker(geometry, wid + 1));
+    }
+
+    PopulationFile file;
+    REQUIRE(file.open(path, geometry, walkers.size()));
+    REQUIRE(! file.was_restored());
+    for(int wid = 0; wid < 5; ++ wid) {
+      file.store(wid, walkers[wid]);
+    }
+    file.set_iteration(7, 10);
+    REQUIRE(file.sync());
+    file.close();
+
+    PopulationFile reopened;
+    REQUIRE(reopened.open(path, geometry, walkers.size()));
+    REQUIRE(reopened.was_restored());
+    REQUIRE(reopened.iteration() == 7);
+    REQUIRE(reopened.iteration_count() == 10);
+
+    Walker loaded;
+    for(int wid = 0; wid < 5; ++ wid) {
+      REQUIRE(reopened.load(wid, & loaded));
+      REQUIRE(loaded.connections() == walkers[wid].connections());
+      REQUIRE(loaded.wired_units().size() == walkers[wid].wired_units().size());
+    }
+    reopened.close();
+
+    // another population size is refused and leaves the file as it was
+    PopulationFile resized;
+    REQUIRE(! resized.open(path, geometry, 3));
+    REQUIRE(! resized.is_open());
+    REQUIRE(reopened.open(path, geometry, walkers.size()));
+    REQUIRE(reopened.was_restored());
+    REQUIRE(reopened.load(4, & loaded));
+    REQUIRE(loaded.connections() == walkers[4].connections());
+  }
+
+  // ids must stay below the "not connected" value of two bytes
+  PopulationFile too_large;
+  REQUIRE(! too_large.open(directory + "/population-too-large", make_geometry(21845, 3), 1));
+  REQUIRE(! too_large.is_open());
+
+  remove_directory(directory);
+}
+
+TEST_CASE("Can keep the walkers of a search in a population file", "[population_file]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  string directory = make_temp_directory();
+  string path = directory + "/population";
+
+  StochasticSearch first(poly, 12, params);
+  first.set_seed(44);
+  first.set_verbose(false);
+  REQUIRE(first.set_population_file(path, 2));
+  first.train(4, 10, 10, np);
+  REQUIRE(first.set_population_file("", 0));
+
+  // a new search on the same file starts from the walkers of the first one
+  StochasticSearch second(poly, 12, params);
+  second.set_verbose(false);
+  REQUIRE(second.set_population_file(path, 2));
+
+  for(int wid = 0; wid < 12; ++ wid) {
+    REQUIRE(first.walker(wid).connections() == second.walker(wid).connections());
+  }
+  REQUIRE(second.set_population_file("", 0));
+
+  // a population stored halfway through a run goes on from where it was
+  {
+    PopulationFile file;
+    REQUIRE(file.open(path, default_geometry(), 12));
+    file.set_iteration(3, 5);
+    REQUIRE(file.sync());
+  }
+
+  StochasticSearch third(poly, 12, params);
+  REQUIRE(third.set_population_file(path, 2));
+
+  ostringstream output;
+  auto previous = cout.rdbuf(output.rdbuf());
+  third.train(5, 10, 10, np);
+  cout.rdbuf(previous);
+
+  string log = output.str();
+  REQUIRE(log.find("Performing iteration [ 3 / 5 ]") == string::npos);
+  REQUIRE(log.find("Performing iteration [ 4 / 5 ]") != string::npos);
+  REQUIRE(log.find("Performing iteration [ 5 / 5 ]") != string::npos);
+
+  PopulationFile stored;
+  REQUIRE(! stored.open(path, default_geometry(), 10));
+  REQUIRE(stored.open(path, default_geometry(), 12));
+  REQUIRE(stored.iteration() == 5);
+  REQUIRE(stored.iteration_count() == 5);
+
+  remove_directory(directory);
+}
@@ -27,7 +27,7 @@ TEST_CASE("Can find upstream connection", "[propagation]" ) {
 
 TEST_CASE("Can compute polynomial operations", "[propagation]" ) {
   UnitOutput p1{true, true, {3, 2}};
-  UnitOutput p2{true, true, {5, 7}};
+  UnitOutput p2{true, true, {7, 5}};
   vector<int> expected_add{7, 5, 3, 2};
   vector<int> expected_mult{10, 9, 8, 7};
 
@@ -58,3 +58,79 @@ TEST_CASE("Can compute polynomial operations", "[propagation]" ) {
   REQUIRE(output.is_valid);
   REQUIRE(output.poly == expected_div);
 }
+
+TEST_CASE("Can invalidate outputs over the limits", "[propagation]" ) {
+  UnitOutput p1{true, true, {6, 4, 2}};
+  UnitOutput p2{true, true, {5, 3, 1}};
+  PropagationLimits limits{10, 8};
+  PropagationStats stats{0, 0};
+
+  int add = 0;
+  int multiply = 1;
+
+  // 6 terms and a degree of 6 are within the limits
+  auto output = compute_one_unit_output(add, p1, p2, limits, & stats);
+  REQUIRE(output.is_valid);
+
+  // the product would have a degree of 11
+  output = compute_one_unit_output(multiply, p1, p2, limits, & stats);
+  REQUIRE(output.has_output);
+  REQUIRE(! output.is_valid);
+  REQUIRE(stats.degree_limit_hits == 1);
+
+  // the product would have 9 terms
+  limits.max_degree = 20;
+  output = compute_one_unit_output(multiply, p1, p2, limits, & stats);
+  REQUIRE(! output.is_valid);
+  REQUIRE(stats.term_limit_hits == 1);
+}
+
+TEST_CASE("Can detect duplicate powers while merging", "[propagation]" ) {
+  poly_t result;
+
+  REQUIRE(add_canonical({5, 3}, {4, 1}, & result));
+  REQUIRE(result == poly_t({5, 4, 3, 1}));
+  REQUIRE(! add_canonical({5, 3}, {3}, & result));
+
+  // (x^3 + x) * (x^2 + 1) = x^5 + x^3 + x^3 + x is invalid
+  REQUIRE(! multiply_canonical({3, 1}, {2, 0}, & result));
+
+  REQUIRE(multiply_canonical({8, 1}, {6, 3, 2}, & result));
+  REQUIRE(result == poly_t({14, 11, 10, 7, 4, 3}));
+}
+
+TEST_CASE("Can propagate on arrays of other geometries", "[propagation]" ) {
+  // one of the specialized sizes, using units on the last rows
+  Geometry large = make_geometry(200, 3);
+  connections_t conns(large.conn_input_count(), -1);
+
+  int mult_id = 199 * 3 + 1;
+  int add_id = 198 * 3;
+  conns[mult_id * 2] = large.array_input_id();
+  conns[mult_id * 2 + 1] = large.array_input_id();
+  conns[add_id * 2] = mult_id;
+  conns[add_id * 2 + 1] = large.array_input_id();
+
+  auto order = compute_propagation_order(conns, large);
+  REQUIRE(order == vector<int>({large.array_input_id(), mult_id, add_id}));
+
+  auto outputs = compute_unit_outputs(conns, order, large);
+  REQUIRE(outputs[add_id].is_valid);
+  REQUIRE(outputs[add_id].poly == poly_t({2, 1}));
+
+  // a generic geometry with only multipliers and adders
+  Geometry mixed{7, {1, 0}};
+  REQUIRE(! mixed.has_default_colls());
+  conns.assign(mixed.conn_input_count(), -1);
+
+  conns[0] = mixed.array_input_id();
+  conns[1] = mixed.array_input_id();
+  conns[2 * 2] = 0;
+  conns[2 * 2 + 1] = 0;
+
+  order = compute_propagation_order(conns, mixed);
+  outputs = compute_unit_outputs(conns, order, mixed);
+  REQUIRE(outputs[0].poly == poly_t({2}));
+  REQUIRE(outputs[2].poly == poly_t({4}));
+  REQUIRE(has_upstream_conn(conns, 2, mixed.array_input_id(), mixed));
+}
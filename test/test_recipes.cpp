@@ -0,0 +1,105 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include "../src/recipes.h"
+#include "../src/stochastic_search.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+using namespace recipes;
+using namespace propagation;
+
+// true if some unit of the walker outputs exactly x^power
+static bool outputs_power(Walker * walker, int power) {
+  auto & outputs = walker->unit_outputs(DEFAULT_LIMITS);
+  for(int unit_id = 0; unit_id < walker->geometry().array_input_id(); ++ unit_id) {
+    if(outputs[unit_id].is_valid && outputs[unit_id].poly == poly_t {power}) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST_CASE("Can place recipes at any row", "[recipes]" ) {
+  Geometry const & geometry = default_geometry();
+
+  Recipe cube;
+  REQUIRE(make_power_recipe(geometry, 3, & cube));
+  REQUIRE(cube.row_count == 2);
+  REQUIRE(! make_power_recipe(geometry, 1, & cube));
+  REQUIRE(! make_power_recipe(make_geometry(10, 1), 3, & cube));
+  REQUIRE(make_power_recipe(geometry, 3, & cube));
+
+  Walker walker(geometry);
+  REQUIRE(place_recipe(cube, 10, & walker));
+  REQUIRE(outputs_power(& walker, 3));
+  REQUIRE(walker.wired_units().size() == 2);
+
+  // units in use and rows past the end of the array are refused
+  REQUIRE(! place_recipe(cube, 11, & walker));
+  REQUIRE(! place_recipe(cube, 49, & walker));
+  REQUIRE(place_recipe(cube, 12, & walker));
+  REQUIRE(walker.wired_units().size() == 4);
+
+  // cutting the recipe out again gives the same wires, starting from row 0
+  Recipe extracted;
+  REQUIRE(extract_recipe(& walker, {3}, DEFAULT_LIMITS, & extracted));
+  REQUIRE(extracted.row_count == cube.row_count);
+  REQUIRE(extracted.wires == cube.wires);
+  REQUIRE(! extract_recipe(& walker, {5}, DEFAULT_LIMITS, & extracted));
+}
+
+TEST_CASE("Can prefer smaller recipes from the solution database", "[recipes]" ) {
+  Geometry const & geometry = default_geometry();
+  string directory = make_temp_directory();
+
+  // x^4 as (x * x) * (x * x) takes 2 rows instead of 3 for the chain
+  Walker squares(geometry);
+  int array_input_id = geometry.array_input_id();
+  squares.rewire(4 * 2, array_input_id);
+  squares.rewire(4 * 2 + 1, array_input_id);
+  squares.rewire(7 * 2, 4);
+  squares.rewire(7 * 2 + 1, 4);
+
+  SolutionDatabase database;
+  REQUIRE(database.open(directory + "/solutions"));
+  REQUIRE(database.add({4}, geometry, BestCircuit {1.0, squares.connections(), 2, true}));
+
+  vector<Recipe> library;
+  make_recipe_library({4, 2, 1}, geometry, nullptr, DEFAULT_LIMITS, & library);
+  REQUIRE(library.size() == 2);
+  REQUIRE(library[0].row_count == 3);
+
+  make_recipe_library({4, 2, 1}, geometry, & database, DEFAULT_LIMITS, & library);
+  REQUIRE(library.size() == 2);
+  REQUIRE(library[0].output == poly_t {4});
+  REQUIRE(library[0].row_count == 2);
+  REQUIRE(library[0].wires.size() == 4);
+
+  database.close();
+  remove_directory(directory);
+}
+
+TEST_CASE("Can warm start a search from recipes", "[recipes]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  StochasticSearch search(poly, 12, params);
+  search.set_seed(47);
+  search.set_verbose(false);
+  search.warm_start();
+
+  // every walker starts with both terms of the target
+  vector<Walker> walkers;
+  search.get_best_walkers(12, & walkers);
+  for(auto & walker : walkers) {
+    REQUIRE(outputs_power(& walker, 3));
+    REQUIRE(outputs_power(& walker, 7));
+  }
+
+  search.train(2, 10, 10, np);
+}
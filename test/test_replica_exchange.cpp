@@ -0,0 +1,41 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include "../src/replica_exchange.h"
+#include "../src/scoring.h"
+
+using namespace std;
+using namespace scoring;
+
+TEST_CASE("Can swap walkers between replicas at fixed noise levels", "[replica_exchange]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  vector<double> noise_levels {0.3, 0.02, 0.1};
+
+  ReplicaExchange first(poly, noise_levels, 10, params);
+  first.set_seed(50);
+  first.set_exchange({2, 3, 10.0});
+  auto first_score = first.train(8, 5, 5, np);
+
+  REQUIRE(first.replica_count() == 3);
+  auto rates = first.acceptance_rates();
+  REQUIRE(rates.size() == 2);
+  for(double rate : rates) {
+    REQUIRE(rate >= 0.0);
+    REQUIRE(rate <= 1.0);
+  }
+  REQUIRE(first_score.best_score == first.best_circuits()->snapshot()->front().score);
+
+  // replicas train on their own threads, yet swaps only happen between rounds
+  ReplicaExchange second(poly, noise_levels, 10, params);
+  second.set_seed(50);
+  second.set_exchange({2, 3, 10.0});
+  auto second_score = second.train(8, 5, 5, np);
+
+  REQUIRE(second_score.best_score == first_score.best_score);
+  REQUIRE(second.acceptance_rates() == rates);
+  for(int level = 0; level < 3; ++ level) {
+    REQUIRE(second.best_per_replica()[level].best_score == first.best_per_replica()[level].best_score);
+  }
+}
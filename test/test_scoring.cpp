@@ -1,6 +1,9 @@
 #include "../extern/catch.hpp"
 
 #include <iostream>
+#include <random>
+#include <algorithm>
+#include <cmath>
 #include "../src/stochastic_search.h"
 #include "../src/scoring.h"
 
@@ -89,3 +92,78 @@ TEST_CASE("Can compute length for one wire #3", "[scoring]") {
 
   REQUIRE(actual_len == 4);
 }
+
+TEST_CASE("Can compute distance from a scoring plan", "[scoring]" ) {
+  mt19937 rng(7);
+  uniform_int_distribution<int> dist_power(1, 30);
+  uniform_int_distribution<int> dist_count(1, 6);
+
+  // compare against the direct computation on random polynomials
+  for(int trial = 0; trial < 200; ++ trial) {
+    poly_t target;
+    poly_t candidate;
+    for(int tid = dist_count(rng); tid > 0; -- tid) {
+      target.push_back(dist_power(rng));
+    }
+    for(int cid = dist_count(rng); cid > 0; -- cid) {
+      candidate.push_back(dist_power(rng));
+    }
+    sort(target.begin(), target.end(), greater<int>());
+    target.erase(unique(target.begin(), target.end()), target.end());
+    sort(candidate.begin(), candidate.end(), greater<int>());
+    candidate.erase(unique(candidate.begin(), candidate.end()), candidate.end());
+
+    ScoringPlan plan = make_scoring_plan(target, 20);
+    REQUIRE(compute_poly_distance(plan, candidate) == compute_poly_distance(target, candidate));
+  }
+
+  ScoringPlan plan = make_scoring_plan({3, 2, 1}, 10);
+  REQUIRE(compute_poly_distance(plan, {}) == compute_poly_distance(poly_t{3, 2, 1}, {}));
+  REQUIRE(compute_exp_neg_distance(plan, 2) == exp(-2.0));
+  REQUIRE(compute_exp_neg_distance(plan, 100) == exp(-100.0));
+}
+
+TEST_CASE("Can compute top distances of all unit outputs", "[scoring]" ) {
+  poly_t target{7, 3};
+  ScoringPlan plan = make_scoring_plan(target, 20);
+
+  unit_outputs_t unit_outputs = {
+    {true, true, {7, 3}},
+    {false, false, {}},
+    {true, true, {8, 2, 1}},
+    {true, false, {}},
+    {true, true, {1}},
+    {true, true, {7, 3}},
+    {true, true, {6}},
+  };
+
+  vector<double> expected;
+  for(auto & uo : unit_outputs) {
+    if(uo.has_output && uo.is_valid) {
+      expected.push_back(compute_poly_distance(target, uo.poly));
+    }
+  }
+  sort(expected.begin(), expected.end());
+  expected.resize(3);
+
+  auto summary = compute_top_distances(plan, unit_outputs, 3);
+  REQUIRE(summary.top_distances == expected);
+  REQUIRE(summary.times_recovered == 2);
+}
+
+TEST_CASE("Can compute length for one wire on a wider array", "[scoring]") {
+  /* Same wire as #2 on an array with 4 columns (should be 4):
+   *    0123
+   *    ----
+   * 0: 0010
+   * 1: 0000
+   * 2: 1000
+   */
+  Geometry geometry = make_geometry(10, 4);
+  vector<int> wire1 = {
+    0 * 4 + 2,
+    2 * 4 + 0,
+  };
+
+  REQUIRE(compute_one_wire_length(wire1, geometry) == 4);
+}
@@ -0,0 +1,119 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include "../src/solution_database.h"
+#include "../src/stochastic_search.h"
+#include "../src/scoring.h"
+#include "test_helpers.h"
+
+using namespace std;
+using namespace scoring;
+
+static BestCircuit make_circuit(int connected_unit, bool recovered, int wire_length, double score) {
+  connections_t conns(default_geometry().conn_input_count(), -1);
+  conns[0] = default_geometry().array_input_id();
+  conns[4] = connected_unit;
+  return BestCircuit {score, conns, wire_length, recovered};
+}
+
+TEST_CASE("Can store and find solutions by target", "[solution_database]" ) {
+  string directory = make_temp_directory();
+  string path = directory + "/solutions";
+  Geometry const & geometry = default_geometry();
+
+  {
+    SolutionDatabase database;
+    REQUIRE(database.open(path));
+    REQUIRE(database.add({3, 7}, geometry, make_circuit(0, false, 3, -2.0)));
+    REQUIRE(database.add({7, 3}, geometry, make_circuit(1, true, 5, 1.0)));
+    REQUIRE(database.add({2}, geometry, make_circuit(2, false, 3, -5.0)));
+
+    // the same circuit is not stored again unless it ranks better
+    REQUIRE(! database.add({3, 7}, geometry, make_circuit(0, false, 3, -3.0)));
+    REQUIRE(database.add({3, 7}, geometry, make_circuit(3, true, 4, 0.5)));
+    REQUIRE(database.size() == 4);
+  }
+
+  // the index is rebuilt on open, targets match in any order of their powers
+  SolutionDatabase database;
+  REQUIRE(database.open(path));
+  REQUIRE(database.size() == 4);
+
+  // circuits recovering the target come first by shorter wires, whatever their score
+  vector<BestCircuit> circuits;
+  REQUIRE(database.find({3, 7}, geometry, & circuits));
+  REQUIRE(circuits.size() == 3);
+  REQUIRE(circuits[0].score == 0.5);
+  REQUIRE(circuits[0].wire_length == 4);
+  REQUIRE(circuits[1].conns == make_circuit(1, true, 5, 1.0).conns);
+  REQUIRE(circuits[1].function_recovered);
+  REQUIRE(! circuits[2].function_recovered);
+  REQUIRE(circuits[2].score == -2.0);
+
+  REQUIRE(! database.find({3, 7}, make_geometry(100, 3), & circuits));
+  REQUIRE(! database.find({4}, geometry, & circuits));
+  database.close();
+
+  // a record torn by a crash is dropped and new records go after the others
+  {
+    ofstream file(path, ios::binary | ios::app);
+    file << "torn";
+  }
+  REQUIRE(database.open(path));
+  REQUIRE(database.size() == 4);
+  REQUIRE(database.add({2}, geometry, make_circuit(4, false, 2, -8.0)));
+  database.close();
+
+  // circuits that do not recover the target rank by score, not by their shorter wires
+  REQUIRE(database.open(path));
+  REQUIRE(database.size() == 5);
+  REQUIRE(database.find({2}, geometry, & circuits));
+  REQUIRE(circuits.size() == 2);
+  REQUIRE(circuits[0].score == -5.0);
+  REQUIRE(circuits[1].score == -8.0);
+
+  remove_directory(directory);
+}
+
+TEST_CASE("Can start a search from known solutions", "[solution_database]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  string directory = make_temp_directory();
+
+  auto database = make_shared<SolutionDatabase>();
+  REQUIRE(database->open(directory + "/solutions"));
+
+  StochasticSearch first(poly, 12, params);
+  first.set_seed(45);
+  first.set_verbose(false);
+  first.set_solution_database(database);
+  first.train(4, 10, 10, np);
+
+  // every circuit of the tracker went in, those recovering the target ranked regardless of their score
+  auto snapshot = first.best_circuits()->snapshot();
+  auto expected = min_element(snapshot->begin(), snapshot->end(), [](BestCircuit const & c1, BestCircuit const & c2) {
+    if(c1.function_recovered != c2.function_recovered) {
+      return c1.function_recovered;
+    }
+    return c1.function_recovered ? c1.wire_length < c2.wire_length : c1.score > c2.score;
+  });
+  vector<BestCircuit> circuits;
+  REQUIRE(database->find(poly, default_geometry(), & circuits));
+  REQUIRE(circuits.size() == snapshot->size());
+  REQUIRE(circuits[0].function_recovered == expected->function_recovered);
+  REQUIRE(circuits[0].wire_length == expected->wire_length);
+
+  // the known circuits are scored again in the first cycle of the next search
+  StochasticSearch second(poly, 12, params);
+  second.set_seed(46);
+  second.set_verbose(false);
+  second.set_solution_database(database);
+  second.train(1, 1, 10, np);
+  REQUIRE(second.best_circuits()->snapshot()->front().score >= circuits[0].score);
+
+  remove_directory(directory);
+}
@@ -22,10 +22,120 @@ TEST_CASE("Can run stochastic search", "[stochastic_search]" ) {
     0.7,
     0.05,
     0.1,
-    0.5,
-    3
+    0.5
   };
   poly_t poly {3, 7};
   StochasticSearch ss(poly, 10, params);
   ss.train(20, 30, 10, np);
 }
+
+TEST_CASE("Can run stochastic search with the fingerprint prefilter", "[stochastic_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {2, 1};
+
+  // recoveries found symbolically are exact, so checking them numerically changes nothing
+  StochasticSearch full(poly, 10, params);
+  StochasticSearch prefiltered(poly, 10, params);
+  full.set_seed(47);
+  prefiltered.set_seed(47);
+  full.set_verbose(false);
+  prefiltered.set_verbose(false);
+  prefiltered.set_fingerprint_prefilter(true);
+
+  int times_recovered = 0;
+  for(int iter_id = 0; iter_id < 5; ++ iter_id) {
+    auto full_out = full.train_iteration(iter_id, 5, 10, 10, np);
+    auto prefiltered_out = prefiltered.train_iteration(iter_id, 5, 10, 10, np);
+    REQUIRE(prefiltered_out.times_function_recovered == full_out.times_function_recovered);
+    REQUIRE(prefiltered_out.best_score == full_out.best_score);
+    times_recovered += full_out.times_function_recovered;
+  }
+  REQUIRE(times_recovered > 0);
+  REQUIRE(prefiltered.best_circuits()->snapshot()->front().conns ==
+          full.best_circuits()->snapshot()->front().conns);
+}
+
+TEST_CASE("Can run stochastic search on a larger array", "[stochastic_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+  StochasticSearch ss(poly, 10, params, make_geometry(200, 3));
+  ss.train(5, 10, 10, np);
+}
+
+TEST_CASE("Can run loops on a work stealing pool", "[stochastic_search]" ) {
+  utils::work_stealing_pool pool(3);
+
+  // uneven costs so that threads run out of their own chunks at different times
+  vector<int> visits(1000, 0);
+  pool.parallel_for(visits.size(), 7, [&visits](int begin, int end, int) {
+    for(int index = begin; index < end; ++ index) {
+      volatile double sink = 0;
+      for(int step = 0; step < (index < 100 ? 20000 : 10); ++ step) {
+        sink = sink + step;
+      }
+      ++ visits[index];
+    }
+  });
+  REQUIRE(visits == vector<int>(1000, 1));
+
+  long task_count = 0;
+  for(auto & stats : pool.statistics()) {
+    task_count += stats.task_count;
+  }
+  REQUIRE(task_count == (1000 / 3 / 7 + 1) * 3);
+}
+
+TEST_CASE("Can run stochastic search on several threads", "[stochastic_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  StochasticSearch sequential(poly, 20, params);
+  sequential.set_seed(41);
+  sequential.set_verbose(false);
+  sequential.train(5, 10, 10, np);
+
+  StochasticSearch parallel(poly, 20, params);
+  parallel.set_seed(41);
+  parallel.set_thread_count(3);
+  parallel.train(5, 10, 10, np);
+
+  // walkers draw their own random numbers, so threads do not change the outcome
+  vector<Walker> sequential_best;
+  vector<Walker> parallel_best;
+  sequential.get_best_walkers(5, & sequential_best);
+  parallel.get_best_walkers(5, & parallel_best);
+  for(int wid = 0; wid < 5; ++ wid) {
+    REQUIRE(sequential_best[wid].connections() == parallel_best[wid].connections());
+  }
+}
+
+TEST_CASE("Can run stochastic search in pipelined mode", "[stochastic_search]" ) {
+  ScoringParams params {1.0, 1.0, 1.0, 0.2, 1.0, 100.0, 10.0, 10.0};
+  NoiseParams np {0.7, 0.05, 0.1, 0.5};
+  poly_t poly {3, 7};
+
+  StochasticSearch sequential(poly, 24, params);
+  sequential.set_seed(42);
+  sequential.set_verbose(false);
+  sequential.set_pipeline_batch_count(4);
+  sequential.train(5, 10, 10, np);
+
+  StochasticSearch parallel(poly, 24, params);
+  parallel.set_seed(42);
+  parallel.set_thread_count(3);
+  parallel.set_pipeline_batch_count(4);
+  parallel.train(5, 10, 10, np);
+
+  // stages work on different batches, so threads do not change the outcome either
+  vector<Walker> sequential_best;
+  vector<Walker> parallel_best;
+  sequential.get_best_walkers(5, & sequential_best);
+  parallel.get_best_walkers(5, & parallel_best);
+  for(int wid = 0; wid < 5; ++ wid) {
+    REQUIRE(sequential_best[wid].connections() == parallel_best[wid].connections());
+  }
+  REQUIRE(! sequential_best[0].wired_units().empty());
+}
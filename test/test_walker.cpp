@@ -0,0 +1,329 @@
+#include "../extern/catch.hpp"
+
+#include <iostream>
+#include <random>
+#include <set>
+#include <algorithm>
+#include "../src/walker.h"
+#include "../src/propagation.h"
+#include "../src/scoring.h"
+
+using namespace std;
+using namespace propagation;
+using namespace scoring;
+
+TEST_CASE("Can keep track of wired units", "[walker]" ) {
+  Walker walker;
+  REQUIRE(walker.wired_units().empty());
+
+  walker.rewire(3 * 2, ARRAY_INPUT_ID);
+  walker.rewire(3 * 2 + 1, 7);
+  walker.rewire(9 * 2 + 1, 3);
+  REQUIRE(walker.wired_units().size() == 2);
+
+  // the unit stays wired until both of its inputs are disconnected
+  walker.rewire(3 * 2, -1);
+  REQUIRE(walker.wired_units().size() == 2);
+  walker.rewire(3 * 2 + 1, -1);
+  REQUIRE(walker.wired_units() == vector<int>({9}));
+  REQUIRE(walker.input(9 * 2 + 1) == 3);
+}
+
+TEST_CASE("Can propagate using only the wired units", "[walker]" ) {
+  mt19937 rng(11);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  // random walkers, including cycles and disconnections, must match the dense computation
+  for(int trial = 0; trial < 50; ++ trial) {
+    Walker walker;
+    for(int cid = 0; cid < 20 + trial * 4; ++ cid) {
+      walker.rewire(dist_inputs(rng), dist_units(rng));
+    }
+
+    auto conns = walker.connections();
+    REQUIRE(compute_propagation_order(conns, walker.wired_units()) == compute_propagation_order(conns));
+    REQUIRE(compute_wire_lengths(conns, walker.wired_units()) == compute_wire_lengths(conns));
+  }
+}
+
+TEST_CASE("Can maintain structural counters", "[walker]" ) {
+  mt19937 rng(5);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  Walker walker;
+  for(int cid = 0; cid < 500; ++ cid) {
+    walker.rewire(dist_inputs(rng), dist_units(rng));
+
+    // recount everything from scratch
+    auto conns = walker.connections();
+    bool input_connected = false;
+    int one_input = 0;
+    int both_inputs = 0;
+    for(int input_id = 0; input_id < conns.size(); input_id += 2) {
+      input_connected |= conns[input_id] == ARRAY_INPUT_ID || conns[input_id + 1] == ARRAY_INPUT_ID;
+      if(conns[input_id] != -1 && conns[input_id + 1] != -1) {
+        ++ both_inputs;
+      } else if(conns[input_id] != -1 || conns[input_id + 1] != -1) {
+        ++ one_input;
+      }
+    }
+
+    REQUIRE(walker.is_array_input_connected() == input_connected);
+    REQUIRE(walker.count_one_input_connected() == one_input);
+    REQUIRE(walker.count_both_inputs_connected() == both_inputs);
+  }
+
+  // copies keep their counters
+  Walker clone = walker;
+  REQUIRE(clone.count_both_inputs_connected() == walker.count_both_inputs_connected());
+}
+
+TEST_CASE("Can keep derived caches in sync with the journal", "[walker]" ) {
+  mt19937 rng(3);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+  uniform_int_distribution<int> dist_changes(1, 100);
+
+  Walker walker;
+  Walker other;
+  for(int step = 0; step < 200; ++ step) {
+    long revision = walker.revision();
+
+    // a burst of changes, sometimes longer than the journal
+    int change_count = dist_changes(rng);
+    for(int cid = 0; cid < change_count; ++ cid) {
+      walker.rewire(dist_inputs(rng), dist_units(rng));
+    }
+    if(step % 37 == 0) {
+      walker.reset();
+    }
+    if(step % 23 == 0) {
+      other.clone_from(walker);
+      REQUIRE(other.connections() == walker.connections());
+    }
+    REQUIRE(walker.revision() > revision);
+
+    // the caches must match a computation from scratch
+    auto conns = walker.connections();
+    auto expected_order = compute_propagation_order(conns);
+    REQUIRE(walker.outgoing_connections() == compute_output_mapping_from_connections(conns));
+    REQUIRE(walker.propagation_order() == expected_order);
+    REQUIRE(walker.wire_lengths() == compute_wire_lengths(conns));
+
+    auto expected_outputs = compute_unit_outputs(conns, expected_order);
+    auto & outputs = walker.unit_outputs(DEFAULT_LIMITS);
+    for(int unit_id = 0; unit_id < CONN_UNIT_COUNT; ++ unit_id) {
+      REQUIRE(outputs[unit_id].has_output == expected_outputs[unit_id].has_output);
+      REQUIRE(outputs[unit_id].is_valid == expected_outputs[unit_id].is_valid);
+      REQUIRE(outputs[unit_id].poly == expected_outputs[unit_id].poly);
+    }
+  }
+
+  // a clone keeps working from the caches of its source
+  REQUIRE(other.wire_lengths() == compute_wire_lengths(other.connections()));
+}
+
+TEST_CASE("Can keep the valid units up to date after each rewire", "[walker]" ) {
+  mt19937 rng(17);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  Walker walker;
+  for(int cid = 0; cid < 1000; ++ cid) {
+    walker.rewire(dist_inputs(rng), dist_units(rng));
+
+    auto conns = walker.connections();
+    auto expected_outputs = compute_unit_outputs(conns, compute_propagation_order(conns));
+    auto & valid = walker.valid_units(DEFAULT_LIMITS);
+
+    int valid_count = 0;
+    for(int unit_id = 0; unit_id < CONN_UNIT_COUNT; ++ unit_id) {
+      REQUIRE(valid.contains(unit_id) == expected_outputs[unit_id].is_valid);
+      valid_count += expected_outputs[unit_id].is_valid;
+    }
+    REQUIRE(valid.size() == valid_count);
+  }
+}
+
+TEST_CASE("Can list the units an input can connect to", "[walker]" ) {
+  Walker walker;
+
+  // x -> 1 (x^2) -> 3 (x^2 + x) -> 5 ((x^2 + x) / x^2 is invalid)
+  walker.rewire(1 * 2, ARRAY_INPUT_ID);
+  walker.rewire(1 * 2 + 1, ARRAY_INPUT_ID);
+  walker.rewire(3 * 2, 1);
+  walker.rewire(3 * 2 + 1, ARRAY_INPUT_ID);
+  walker.rewire(5 * 2, 3);
+  walker.rewire(5 * 2 + 1, 1);
+
+  vector<int> cone;
+  walker.downstream_cone(1, & cone);
+  sort(cone.begin(), cone.end());
+  REQUIRE(cone == vector<int>({1, 3, 5}));
+
+  vector<int> units;
+  walker.connectable_units(3, DEFAULT_LIMITS, nullptr, & units);
+  sort(units.begin(), units.end());
+  REQUIRE(units == vector<int>({1, (int) ARRAY_INPUT_ID}));
+
+  walker.connectable_units(1, DEFAULT_LIMITS, nullptr, & units);
+  REQUIRE(units == vector<int>({(int) ARRAY_INPUT_ID}));
+
+  // sampling only picks among the same units, and picks all of them
+  mt19937 random_generator(38);
+  set<int> sampled;
+  for(int sample = 0; sample < 100; ++ sample) {
+    sampled.insert(walker.sample_connectable_unit(3, DEFAULT_LIMITS, nullptr, & random_generator));
+  }
+  REQUIRE(sampled == set<int>({1, (int) ARRAY_INPUT_ID}));
+  REQUIRE(walker.sample_connectable_unit(1, DEFAULT_LIMITS, nullptr, & random_generator) == ARRAY_INPUT_ID);
+}
+
+TEST_CASE("Can keep the members of an ordered sparse set in order", "[walker]" ) {
+  utils::sparse_set values(50, true);
+  set<int> expected;
+  mt19937 random_generator(39);
+  uniform_int_distribution<int> dist_values(0, 49);
+
+  for(int step = 0; step < 500; ++ step) {
+    int value = dist_values(random_generator);
+    if(step % 3 == 0) {
+      values.erase(value);
+      expected.erase(value);
+    } else {
+      values.insert(value);
+      expected.insert(value);
+    }
+
+    REQUIRE(values.values() == vector<int>(expected.begin(), expected.end()));
+    for(int position = 0; position < values.size(); ++ position) {
+      REQUIRE(values.contains(values.at(position)));
+    }
+    for(int other = 0; other < 50; ++ other) {
+      REQUIRE(values.contains(other) == (expected.count(other) == 1));
+    }
+  }
+}
+
+TEST_CASE("Can maintain which units are upstream of which", "[walker]" ) {
+  Walker walker;
+  mt19937 random_generator(37);
+
+  // rewire among a few units so that paths, parallel edges and cycles are common
+  uniform_int_distribution<int> dist_inputs(0, 2 * 12 - 1);
+  uniform_int_distribution<int> dist_units(-1, 12);
+
+  for(int step = 0; step < 300; ++ step) {
+    int unit_id = dist_units(random_generator);
+    walker.rewire(dist_inputs(random_generator), unit_id == 12 ? (int) ARRAY_INPUT_ID : unit_id);
+    if(step == 150) {
+      walker.reset();
+    }
+
+    for(int upstream_unit_id = 0; upstream_unit_id < 12; ++ upstream_unit_id) {
+      for(int downstream_unit_id = 0; downstream_unit_id < 12; ++ downstream_unit_id) {
+        REQUIRE(walker.is_upstream(upstream_unit_id, downstream_unit_id) ==
+                has_upstream_conn(walker.connections(), downstream_unit_id, upstream_unit_id));
+      }
+      REQUIRE(walker.is_upstream(ARRAY_INPUT_ID, upstream_unit_id) ==
+              has_upstream_conn(walker.connections(), upstream_unit_id, ARRAY_INPUT_ID));
+    }
+  }
+}
+
+TEST_CASE("Can change clones independently of their source", "[walker]" ) {
+  mt19937 random_generator(38);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  Walker walker;
+  for(int step = 0; step < 100; ++ step) {
+    walker.rewire(dist_inputs(random_generator), dist_units(random_generator));
+  }
+
+  // clones of clones, each changed a little after cloning
+  vector<Walker> clones(4);
+  vector<connections_t> expected_conns;
+  for(int cid = 0; cid < clones.size(); ++ cid) {
+    clones[cid].clone_from(cid == 0 ? walker : clones[cid - 1]);
+    expected_conns.push_back(clones[cid].connections());
+
+    for(int step = 0; step < 3; ++ step) {
+      int input_id = dist_inputs(random_generator);
+      int unit_id = dist_units(random_generator);
+      clones[cid].rewire(input_id, unit_id);
+      expected_conns[cid][input_id] = unit_id;
+    }
+  }
+  auto expected_walker_conns = walker.connections();
+  walker.reset();
+
+  REQUIRE(walker.connections() == connections_t(CONN_INPUT_COUNT, -1));
+  for(int cid = 0; cid < clones.size(); ++ cid) {
+    auto conns = clones[cid].connections();
+    REQUIRE(conns == expected_conns[cid]);
+
+    for(int upstream_unit_id = 0; upstream_unit_id < CONN_UNIT_COUNT; upstream_unit_id += 7) {
+      for(int downstream_unit_id = 0; downstream_unit_id < UNIT_COUNT; ++ downstream_unit_id) {
+        REQUIRE(clones[cid].is_upstream(upstream_unit_id, downstream_unit_id) ==
+                has_upstream_conn(conns, downstream_unit_id, upstream_unit_id));
+      }
+    }
+  }
+  REQUIRE(expected_walker_conns != walker.connections());
+}
+
+TEST_CASE("Can update the caches of a clone without touching those of its source", "[walker]" ) {
+  mt19937 random_generator(39);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  Walker walker;
+  for(int step = 0; step < 200; ++ step) {
+    walker.rewire(dist_inputs(random_generator), dist_units(random_generator));
+  }
+  auto conns = walker.connections();
+  auto expected_outputs = compute_unit_outputs(conns, compute_propagation_order(conns));
+  walker.unit_outputs(DEFAULT_LIMITS);
+  walker.wire_lengths();
+
+  Walker clone;
+  clone.clone_from(walker);
+  for(int step = 0; step < 10; ++ step) {
+    clone.rewire(dist_inputs(random_generator), dist_units(random_generator));
+  }
+  clone.unit_outputs(DEFAULT_LIMITS);
+  clone.wire_lengths();
+
+  // the shared caches were copied by the clone before it changed them
+  auto & outputs = walker.unit_outputs(DEFAULT_LIMITS);
+  for(int unit_id = 0; unit_id < CONN_UNIT_COUNT; ++ unit_id) {
+    REQUIRE(outputs[unit_id].is_valid == expected_outputs[unit_id].is_valid);
+    REQUIRE(outputs[unit_id].poly == expected_outputs[unit_id].poly);
+  }
+  REQUIRE(walker.outgoing_connections() == compute_output_mapping_from_connections(conns));
+  REQUIRE(walker.wire_lengths() == compute_wire_lengths(conns));
+
+  connections_t stored;
+  walker.connection_array().copy_to(& stored);
+  REQUIRE(stored == conns);
+}
+
+TEST_CASE("Can build a walker from its connections", "[walker]" ) {
+  mt19937 random_generator(40);
+  uniform_int_distribution<int> dist_inputs(0, CONN_INPUT_COUNT - 1);
+  uniform_int_distribution<int> dist_units(-1, ARRAY_INPUT_ID);
+
+  Walker walker;
+  for(int step = 0; step < 100; ++ step) {
+    walker.rewire(dist_inputs(random_generator), dist_units(random_generator));
+  }
+
+  Walker rebuilt(default_geometry(), walker.connections());
+  REQUIRE(rebuilt.connections() == walker.connections());
+  REQUIRE(rebuilt.count_both_inputs_connected() == walker.count_both_inputs_connected());
+  REQUIRE(rebuilt.propagation_order() == walker.propagation_order());
+  REQUIRE(rebuilt.wire_lengths() == walker.wire_lengths());
+}